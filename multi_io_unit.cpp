@@ -16,8 +16,11 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <limits>
 
 #include "multi_io_unit.h"
 
@@ -25,6 +28,10 @@ using namespace std;
 
 namespace vlsv {
 
+   /** Units whose mean byte size is less than this are packed to a staging buffer 
+    * when iostrategy::AUTO is used, see test/io_strategy for measurements.*/
+   static const uint64_t MAX_PACKED_MEAN_UNIT_BYTES = 1024;
+
    /** Constructor for struct Multi_IO_Unit.
     * NOTE: MPI datatypes passed to Multi_IO_Unit are not committed or freed, 
     * thus one should only use native MPI datatypes, e.g. as returned by 
@@ -35,5 +42,210 @@ namespace vlsv {
     * @param mpiType MPI datatype defining the I/O operation.
     * @param amount Amount of data to be written or read, in units of mpiType.*/
    Multi_IO_Unit::Multi_IO_Unit(char* array,const MPI_Datatype& mpiType,const uint64_t& amount): array(array),mpiType(mpiType),amount(amount) { }
+
+   /** Constructor for class Multi_IO_Buffer. By default merged units are 
+    * limited to the largest byte count that fits into an int.*/
+   Multi_IO_Buffer::Multi_IO_Buffer(): bytes(0),lastTypeBytes(0),maxUnitBytes(numeric_limits<int>::max()) { }
+
+   /** Add all units of another buffer to the end of this buffer. The first unit 
+    * of other is merged into the last unit of this buffer if possible.
+    * @param other Buffer whose units are added.*/
+   void Multi_IO_Buffer::append(const Multi_IO_Buffer& other) {
+      for (const_iterator it=other.begin(); it!=other.end(); ++it) push_back(*it);
+   }
+
+   Multi_IO_Buffer::iterator Multi_IO_Buffer::begin() {return units.begin();}
+
+   Multi_IO_Buffer::const_iterator Multi_IO_Buffer::begin() const {return units.begin();}
+
+   /** Remove all units. Memory reserved for units is kept for reuse.*/
+   void Multi_IO_Buffer::clear() {
+      units.clear();
+      bytes = 0;
+      lastTypeBytes = 0;
+   }
+
+   bool Multi_IO_Buffer::empty() const {return units.empty();}
+
+   Multi_IO_Buffer::iterator Multi_IO_Buffer::end() {return units.end();}
+
+   Multi_IO_Buffer::const_iterator Multi_IO_Buffer::end() const {return units.end();}
+
+   Multi_IO_Unit& Multi_IO_Buffer::front() {return units.front();}
+
+   /** Get the total number of bytes in stored units.
+    * @return Number of bytes read or written by stored units.*/
+   uint64_t Multi_IO_Buffer::getBytes() const {return bytes;}
+
+   /** Add a unit to the buffer. If the unit continues the previously added unit 
+    * in memory and has the same MPI datatype, the previous unit is extended instead.
+    * @param unit Added unit.*/
+   void Multi_IO_Buffer::push_back(const Multi_IO_Unit& unit) {
+      if (units.empty() == false && units.back().mpiType == unit.mpiType) {
+         Multi_IO_Unit& last = units.back();
+         if (last.array + last.amount*lastTypeBytes == unit.array
+             && (last.amount+unit.amount)*lastTypeBytes <= maxUnitBytes) {
+            last.amount += unit.amount;
+            bytes += unit.amount*lastTypeBytes;
+            return;
+         }
+      } else {
+         MPI_Type_size(unit.mpiType,&lastTypeBytes);
+      }
+      units.push_back(unit);
+      bytes += unit.amount*lastTypeBytes;
+   }
+
+   /** Set the maximum byte size of merged units. Units larger than this 
+    * are stored as given, but they are never extended.
+    * @param maxUnitBytes Maximum byte size of a merged unit.*/
+   void Multi_IO_Buffer::setMaxUnitBytes(const uint64_t& maxUnitBytes) {
+      this->maxUnitBytes = maxUnitBytes;
+   }
+
+   size_t Multi_IO_Buffer::size() const {return units.size();}
+
+   /** Swap the contents of two buffers.
+    * @param other Buffer whose contents are swapped with this buffer.*/
+   void Multi_IO_Buffer::swap(Multi_IO_Buffer& other) {
+      units.swap(other.units);
+      std::swap(bytes,other.bytes);
+      std::swap(lastTypeBytes,other.lastTypeBytes);
+      std::swap(maxUnitBytes,other.maxUnitBytes);
+   }
    
+   /** Create an MPI datatype that describes the given units. Displacements are 
+    * relative to the memory of the first unit. The returned datatype is committed 
+    * and must be freed by the caller.
+    * @param strategy Either iostrategy::INDEXED or iostrategy::STRUCT. An indexed 
+    * datatype can only be used if all units have the same MPI datatype.
+    * @param start Iterator pointing to the first unit.
+    * @param stop Iterator pointing past the last unit, must not be equal to start.
+    * @param blockLengths Array used in datatype creation, grown if needed and reused by the caller.
+    * @param displacements Array used in datatype creation, grown if needed and reused by the caller.
+    * @param types Array used in datatype creation, grown if needed and reused by the caller.
+    * @return Committed MPI datatype.*/
+   MPI_Datatype createUnitDatatype(const iostrategy::type& strategy,Multi_IO_Buffer::const_iterator start,
+                                   Multi_IO_Buffer::const_iterator stop,std::vector<int>& blockLengths,
+                                   std::vector<MPI_Aint>& displacements,std::vector<MPI_Datatype>& types) {
+      const size_t N_units = stop - start;
+      if (blockLengths.size() < N_units) {
+         blockLengths.resize(N_units);
+         displacements.resize(N_units);
+         types.resize(N_units);
+      }
+
+      // Copy pointers etc. to MPI datatype arrays:
+      const char* base = start->array;
+      bool sameLength = true;
+      size_t i=0;
+      for (Multi_IO_Buffer::const_iterator it=start; it!=stop; ++it) {
+         blockLengths[i]  = it->amount;
+         displacements[i] = it->array - base;
+         types[i]         = it->mpiType;
+         if (it->amount != start->amount) sameLength = false;
+         ++i;
+      }
+
+      MPI_Datatype datatype;
+      if (strategy == iostrategy::INDEXED && sameLength == true) {
+         #if MPI_VERSION >= 3
+            MPI_Type_create_hindexed_block(N_units,blockLengths[0],&(displacements[0]),start->mpiType,&datatype);
+         #else
+            MPI_Type_create_hindexed(N_units,&(blockLengths[0]),&(displacements[0]),start->mpiType,&datatype);
+         #endif
+      } else if (strategy == iostrategy::INDEXED) {
+         MPI_Type_create_hindexed(N_units,&(blockLengths[0]),&(displacements[0]),start->mpiType,&datatype);
+      } else {
+         MPI_Type_create_struct(N_units,&(blockLengths[0]),&(displacements[0]),&(types[0]),&datatype);
+      }
+      MPI_Type_commit(&datatype);
+      return datatype;
+   }
+
+   /** Get the total number of bytes in the given units.
+    * @param start Iterator pointing to the first unit.
+    * @param stop Iterator pointing past the last unit.
+    * @return Number of bytes in units.*/
+   uint64_t getUnitBytes(Multi_IO_Buffer::const_iterator start,Multi_IO_Buffer::const_iterator stop) {
+      uint64_t bytes = 0;
+      MPI_Datatype previousType = MPI_DATATYPE_NULL;
+      int datatypeBytesize = 0;
+      for (Multi_IO_Buffer::const_iterator it=start; it!=stop; ++it) {
+         if (it->mpiType != previousType) {
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            previousType = it->mpiType;
+         }
+         bytes += it->amount*datatypeBytesize;
+      }
+      return bytes;
+   }
+
+   /** Copy the data of the given units to a contiguous buffer.
+    * @param start Iterator pointing to the first unit.
+    * @param stop Iterator pointing past the last unit.
+    * @param buffer Output buffer, must be at least getUnitBytes(start,stop) bytes in size.*/
+   void packUnits(Multi_IO_Buffer::const_iterator start,Multi_IO_Buffer::const_iterator stop,char* buffer) {
+      MPI_Datatype previousType = MPI_DATATYPE_NULL;
+      int datatypeBytesize = 0;
+      for (Multi_IO_Buffer::const_iterator it=start; it!=stop; ++it) {
+         if (it->mpiType != previousType) {
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            previousType = it->mpiType;
+         }
+         const uint64_t bytes = it->amount*datatypeBytesize;
+         memcpy(buffer,it->array,bytes);
+         buffer += bytes;
+      }
+   }
+
+   /** Select how the given units are transferred with a single collective MPI call.
+    * With iostrategy::AUTO many small units are packed to a staging buffer, because 
+    * MPI implementations process large derived datatypes slowly. Otherwise units 
+    * are described with an indexed datatype if all units have the same MPI datatype, 
+    * and with a struct datatype if they do not.
+    * @param requested Requested strategy.
+    * @param start Iterator pointing to the first unit.
+    * @param stop Iterator pointing past the last unit.
+    * @param bytes Total number of bytes in units.
+    * @param allowPack If false, units are never packed. Packing cannot be used if 
+    * the staging buffer would be reused before the transfer has completed.
+    * @return Strategy that can be used to transfer the units.*/
+   iostrategy::type selectIOStrategy(const iostrategy::type& requested,Multi_IO_Buffer::const_iterator start,
+                                     Multi_IO_Buffer::const_iterator stop,const uint64_t& bytes,const bool& allowPack) {
+      const uint64_t N_units = stop - start;
+      iostrategy::type strategy = requested;
+      if (strategy == iostrategy::AUTO) {
+         if (N_units > 1 && bytes < MAX_PACKED_MEAN_UNIT_BYTES*N_units) strategy = iostrategy::PACK;
+         else strategy = iostrategy::INDEXED;
+      }
+      if (strategy == iostrategy::PACK && allowPack == false) strategy = iostrategy::INDEXED;
+
+      // Indexed datatype requires that all units have the same MPI datatype:
+      if (strategy == iostrategy::INDEXED) {
+         for (Multi_IO_Buffer::const_iterator it=start; it!=stop; ++it) {
+            if (it->mpiType != start->mpiType) return iostrategy::STRUCT;
+         }
+      }
+      return strategy;
+   }
+
+   /** Copy data from a contiguous buffer to the given units.
+    * @param buffer Input buffer, contains getUnitBytes(start,stop) bytes.
+    * @param start Iterator pointing to the first unit.
+    * @param stop Iterator pointing past the last unit.*/
+   void unpackUnits(const char* buffer,Multi_IO_Buffer::const_iterator start,Multi_IO_Buffer::const_iterator stop) {
+      MPI_Datatype previousType = MPI_DATATYPE_NULL;
+      int datatypeBytesize = 0;
+      for (Multi_IO_Buffer::const_iterator it=start; it!=stop; ++it) {
+         if (it->mpiType != previousType) {
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            previousType = it->mpiType;
+         }
+         const uint64_t bytes = it->amount*datatypeBytesize;
+         memcpy(it->array,buffer,bytes);
+         buffer += bytes;
+      }
+   }
+
 } // namespace vlsv
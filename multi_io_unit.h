@@ -21,8 +21,21 @@
 
 #include <stdint.h>
 #include <mpi.h>
+#include <vector>
 
 namespace vlsv {
+
+   namespace iostrategy {
+      /** Methods of transferring multi-I/O units with a single collective MPI call.*/
+      enum type {
+         AUTO,              /**< Method is selected based on the number and mean size of units.*/
+         PACK,              /**< Units are copied to a contiguous staging buffer that is transferred as bytes.*/
+         INDEXED,           /**< Units are described with an hindexed MPI datatype, requires 
+                             * that all units have the same MPI datatype.*/
+         STRUCT             /**< Units are described with an MPI struct datatype.*/
+      };
+   }
+
    /** Definition of a parallel file I/O unit. Processes can 
     * define zero or more file action units for a collective file I/O
     * operation in VLSVWriter and VLSVParReader. Those classes will then 
@@ -42,6 +55,48 @@ namespace vlsv {
       /** Private default constructor to prevent creation of empty multiwrite units.*/
       Multi_IO_Unit();
    };
+
+   /** Contiguous storage for multi-I/O units. Units are stored in a vector whose 
+    * memory is retained when the buffer is cleared, so that adding a unit per cell 
+    * does not allocate memory per unit. A unit whose memory directly follows the memory 
+    * of the previously added unit, and which has the same MPI datatype, is merged 
+    * into the previous unit unless the merged unit would exceed maxUnitBytes.*/
+   class Multi_IO_Buffer {
+    public:
+      typedef std::vector<Multi_IO_Unit>::iterator iterator;
+      typedef std::vector<Multi_IO_Unit>::const_iterator const_iterator;
+
+      Multi_IO_Buffer();
+
+      void append(const Multi_IO_Buffer& other);
+      iterator begin();
+      const_iterator begin() const;
+      void clear();
+      bool empty() const;
+      iterator end();
+      const_iterator end() const;
+      Multi_IO_Unit& front();
+      uint64_t getBytes() const;
+      void push_back(const Multi_IO_Unit& unit);
+      void setMaxUnitBytes(const uint64_t& maxUnitBytes);
+      size_t size() const;
+      void swap(Multi_IO_Buffer& other);
+
+    private:
+      uint64_t bytes;                    /**< Total number of bytes in stored units.*/
+      int lastTypeBytes;                 /**< Byte size of the MPI datatype of the last stored unit.*/
+      uint64_t maxUnitBytes;             /**< Maximum byte size of a merged unit.*/
+      std::vector<Multi_IO_Unit> units;  /**< Stored units.*/
+   };
+
+   MPI_Datatype createUnitDatatype(const iostrategy::type& strategy,Multi_IO_Buffer::const_iterator start,
+                                   Multi_IO_Buffer::const_iterator stop,std::vector<int>& blockLengths,
+                                   std::vector<MPI_Aint>& displacements,std::vector<MPI_Datatype>& types);
+   uint64_t getUnitBytes(Multi_IO_Buffer::const_iterator start,Multi_IO_Buffer::const_iterator stop);
+   void packUnits(Multi_IO_Buffer::const_iterator start,Multi_IO_Buffer::const_iterator stop,char* buffer);
+   iostrategy::type selectIOStrategy(const iostrategy::type& requested,Multi_IO_Buffer::const_iterator start,
+                                     Multi_IO_Buffer::const_iterator stop,const uint64_t& bytes,const bool& allowPack);
+   void unpackUnits(const char* buffer,Multi_IO_Buffer::const_iterator start,Multi_IO_Buffer::const_iterator stop);
 }
 
 #endif
\ No newline at end of file
@@ -16,7 +16,9 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include "muxml.h"
 
@@ -133,6 +135,207 @@ void MuXML::print(std::ostream& out,const int& level,const XMLNode* node) const
    }
 }
 
+/** Append a string to the end of a buffer.
+ * @param buffer Buffer.
+ * @param s Appended string.*/
+static inline void append(std::vector<char>& buffer,const std::string& s) {
+   buffer.insert(buffer.end(),s.begin(),s.end());
+}
+
+/** Serialize the XML tree into a buffer. The output is identical to the output of 
+ * MuXML::print, but it is not written through an ostream. Instead, the buffer is 
+ * passed to the callback function every time it contains at least chunkBytes bytes, 
+ * and after the last node. The buffer is cleared after each callback but its 
+ * capacity is kept, thus the same buffer can be reused to serialize several trees 
+ * without new memory allocations.
+ * @param buffer Buffer in which the XML is written.
+ * @param chunkBytes Approximate number of bytes passed to each callback.
+ * @param callback Function that consumes the serialized XML.
+ * @param userData Pointer that is passed to the callback function.
+ * @return If true, the tree was serialized and all callbacks succeeded.*/
+bool MuXML::serialize(std::vector<char>& buffer,const size_t& chunkBytes,SerializeCallback callback,void* userData) const {
+   buffer.clear();
+   if (buffer.capacity() < chunkBytes + chunkBytes/8) buffer.reserve(chunkBytes + chunkBytes/8);
+   bool success = serialize(buffer,chunkBytes,callback,userData,0,root);
+
+   // Pass the remaining data to the callback:
+   if (buffer.size() > 0) {
+      if ((*callback)(&(buffer[0]),buffer.size(),userData) == false) success = false;
+      buffer.clear();
+   }
+   return success;
+}
+
+bool MuXML::serialize(std::vector<char>& buffer,const size_t& chunkBytes,SerializeCallback callback,void* userData,
+                      const int& level,const XMLNode* node) const {
+   const int tab = 3;
+   for (map<string,XMLNode*>::const_iterator it=node->children.begin(); it!=node->children.end(); ++it) {
+      // Indent, and write child's name, attributes and value:
+      buffer.insert(buffer.end(),level,' ');
+      buffer.push_back('<');
+      append(buffer,it->first);
+      for (map<string,string>::const_iterator jt=it->second->attributes.begin(); jt!=it->second->attributes.end(); ++jt) {
+         buffer.push_back(' ');
+         append(buffer,jt->first);
+         buffer.push_back('=');
+         buffer.push_back('"');
+         append(buffer,jt->second);
+         buffer.push_back('"');
+      }
+      buffer.push_back('>');
+      append(buffer,it->second->value);
+
+      // Serialize child's children:
+      if (it->second->children.size() > 0) {
+         buffer.push_back('\n');
+         if (serialize(buffer,chunkBytes,callback,userData,level+tab,it->second) == false) return false;
+         buffer.insert(buffer.end(),level,' ');
+      }
+
+      // Write child's end tag:
+      buffer.push_back('<');
+      buffer.push_back('/');
+      append(buffer,it->first);
+      buffer.push_back('>');
+      buffer.push_back('\n');
+
+      // Pass a full chunk to the callback:
+      if (buffer.size() >= chunkBytes) {
+         if ((*callback)(&(buffer[0]),buffer.size(),userData) == false) return false;
+         buffer.clear();
+      }
+   }
+   return true;
+}
+
+/** Check if a character is whitespace that separates XML tokens.*/
+static inline bool isSpace(const char& c) {
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/** Skip whitespace.
+ * @param p Current position.
+ * @param end End of data.
+ * @return Position of the first character that is not whitespace, or end.*/
+static inline const char* skipSpace(const char* p,const char* end) {
+   while (p < end && isSpace(*p) == true) ++p;
+   return p;
+}
+
+/** Find a character using memchr.
+ * @param p Current position.
+ * @param end End of data.
+ * @param c Searched character.
+ * @return Position of the first occurrence of c, or NULL if it was not found.*/
+static inline const char* findChar(const char* p,const char* end,const char& c) {
+   if (p >= end) return NULL;
+   return static_cast<const char*>(memchr(p,c,end-p));
+}
+
+/** Parse an XML element and its children, and add it to the tree.
+ * Tokens are located in the data without copying, and only the strings 
+ * stored in the tree are allocated.
+ * @param p Position after the '<' that starts the element.
+ * @param end End of data.
+ * @param parent Parent node of the element.
+ * @return Position after the end tag of the element, or NULL if the 
+ * data ended before the element or it is malformed.*/
+static const char* parseElement(const char* p,const char* end,XMLNode* parent) {
+   // Tag name. Tags and attributes are in sorted order in files written by 
+   // MuXML, thus the end of each map is the correct insertion position:
+   p = skipSpace(p,end);
+   const char* name = p;
+   while (p < end && *p != '>' && isSpace(*p) == false) ++p;
+   if (p == end) return NULL;
+   XMLNode* node = new XMLNode(parent);
+   parent->children.insert(parent->children.end(),make_pair(string(name,p-name),node));
+
+   // Attributes, name="value":
+   while (true) {
+      p = skipSpace(p,end);
+      if (p == end) return NULL;
+      if (*p == '>') {
+         ++p;
+         break;
+      }
+      const char* equals = findChar(p,end,'=');
+      if (equals == NULL) return NULL;
+      const char* quote = findChar(equals+1,end,'"');
+      if (quote == NULL) return NULL;
+      const char* valueEnd = findChar(quote+1,end,'"');
+      if (valueEnd == NULL) return NULL;
+      node->attributes.insert(node->attributes.end(),make_pair(string(p,equals-p),string(quote+1,valueEnd-quote-1)));
+      p = valueEnd+1;
+   }
+
+   // Tag value:
+   p = skipSpace(p,end);
+   const char* value = p;
+   while (p < end && *p != '<' && isSpace(*p) == false) ++p;
+   node->value.assign(value,p-value);
+
+   // Child elements until the end tag:
+   while (true) {
+      p = findChar(p,end,'<');
+      if (p == NULL) return NULL;
+      const char* next = skipSpace(p+1,end);
+      if (next < end && *next == '/') {
+         p = findChar(next,end,'>');
+         if (p == NULL) return NULL;
+         return p+1;
+      }
+      p = parseElement(p+1,end,node);
+      if (p == NULL) return NULL;
+   }
+}
+
+/** Parse an XML document from a buffer. The current contents of the tree are 
+ * replaced. Parsing stops after the root element, because the document may be 
+ * followed by other data. Unlike MuXML::read the data is not read character by 
+ * character from a stream, and there is no limit on the length of names or values.
+ * @param data XML document.
+ * @param bytes Number of bytes in data.
+ * @return If true, a complete root element was parsed.*/
+bool MuXML::parse(const char* data,const size_t& bytes) {
+   clear();
+   const char* p = findChar(data,data+bytes,'<');
+   if (p == NULL) return false;
+   return parseElement(p+1,data+bytes,root) != NULL;
+}
+
+/** Parse an XML document starting from the current position of a stream. The 
+ * stream is read into the given buffer in growing chunks until the root element 
+ * is complete, so that data following the document is not read needlessly. 
+ * The current contents of the tree are replaced.
+ * @param in Input stream.
+ * @param buffer Buffer in which the document is read, it can be reused between calls.
+ * @return If true, a complete root element was parsed.*/
+bool MuXML::parse(std::istream& in,std::vector<char>& buffer) {
+   const streampos start = in.tellg();
+   in.seekg(0,ios::end);
+   const streampos end = in.tellg();
+   in.seekg(start);
+   if (start < 0 || end <= start) {
+      clear();
+      return false;
+   }
+
+   const size_t available = end - start;
+   size_t bytes = min(available,static_cast<size_t>(1024*1024));
+   size_t bytesRead = 0;
+   while (true) {
+      buffer.resize(bytes);
+      in.read(&(buffer[bytesRead]),bytes-bytesRead);
+      if (static_cast<size_t>(in.gcount()) != bytes-bytesRead) break;
+      bytesRead = bytes;
+      if (parse(&(buffer[0]),bytes) == true) return true;
+      if (bytes == available) break;
+      bytes = min(available,4*bytes);
+   }
+   clear();
+   return false;
+}
+
 bool MuXML::read(std::istream& in,XMLNode* parent,const int& level,const char& currentChar) {
    in >> noskipws;
    if (parent == NULL) parent = root;
@@ -223,6 +426,10 @@ bool MuXML::read(std::istream& in,XMLNode* parent,const int& level,const char& c
 	    in >> c;
 	 }
 	 while ((c == ' ' || c == '\t' || c == '\n') && in.good() == true) in >> c;
+
+	 // Document has a single root element. Reading stops after it, 
+	 // because the document may be followed by other data:
+	 if (level == 0) return success;
       }
       
       if (in.good() == false) return false;
@@ -40,6 +40,10 @@ namespace muxml {
       ~XMLNode();
    };
 
+   /** Function that consumes a chunk of serialized XML, see MuXML::serialize. 
+    * Returns false if the chunk could not be consumed.*/
+   typedef bool (*SerializeCallback)(const char* data,const size_t& bytes,void* userData);
+
    class MuXML {
     public:
       MuXML();
@@ -59,11 +63,17 @@ namespace muxml {
 
       void print(std::ostream& out,const int& level=0,const XMLNode* node=NULL) const;
 
+      bool parse(const char* data,const size_t& bytes);
+      bool parse(std::istream& in,std::vector<char>& buffer);
       bool read(std::istream& in,XMLNode* parent=NULL,const int& level=0,const char& currentChar=' ');
+      bool serialize(std::vector<char>& buffer,const size_t& chunkBytes,SerializeCallback callback,void* userData) const;
    
     private:
    
       XMLNode* root; /**< Pointer to root node.*/
+
+      bool serialize(std::vector<char>& buffer,const size_t& chunkBytes,SerializeCallback callback,void* userData,
+                     const int& level,const XMLNode* node) const;
    };
 
    template<typename T> bool MuXML::addAttribute(XMLNode* node,const std::string& attribName,const T& attribValue) {
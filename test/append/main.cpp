@@ -0,0 +1,105 @@
+/** This file is part of VLSV file format.
+ * 
+ *  Copyright 2011-2015 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Tests appending arrays to an existing VLSV file. An array is written to a new file, 
+ * and arrays are then appended to it one file open at a time, the second appended 
+ * array is compressed. All arrays are read back and compared. Compile with
+ * mpic++ -O3 -std=c++0x main.cpp -L../.. -lvlsv -lz
+ * and run with any number of processes.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include "../../vlsv_writer.h"
+#include "../../vlsv_reader_parallel.h"
+
+using namespace std;
+using namespace vlsv;
+
+const int N_ARRAYS = 3;
+
+double value(const int& array,const int& myrank,const uint64_t& i) {
+   return array*1.0e6 + myrank*1.0e3 + i;
+}
+
+string arrayName(const int& array) {
+   stringstream ss;
+   ss << "array" << array;
+   return ss.str();
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myrank,N_processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myrank);
+   MPI_Comm_size(MPI_COMM_WORLD,&N_processes);
+   bool success = true;
+
+   const uint64_t N_values = 1000 + 17*myrank;
+   uint64_t myOffset = 0;
+   MPI_Exscan(const_cast<uint64_t*>(&N_values),&myOffset,1,MPI_UINT64_T,MPI_SUM,MPI_COMM_WORLD);
+   if (myrank == 0) myOffset = 0;
+
+   // First array creates the file, the rest are appended to it:
+   for (int a=0; a<N_ARRAYS; ++a) {
+      vector<double> data(N_values);
+      for (uint64_t i=0; i<N_values; ++i) data[i] = value(a,myrank,i);
+
+      Writer vlsvWriter;
+      if (a == 2) vlsvWriter.setCompression(compression::ZLIB,4096);
+      if (vlsvWriter.open("test_append.vlsv",MPI_COMM_WORLD,0,MPI_INFO_NULL,a > 0) == false) success = false;
+      map<string,string> attribs;
+      attribs["name"] = arrayName(a);
+      if (vlsvWriter.writeArray("VARIABLE",attribs,N_values,1,&(data[0])) == false) success = false;
+      if (vlsvWriter.close() == false) success = false;
+   }
+
+   // Appending to a file that does not exist fails:
+   Writer vlsvWriter;
+   if (vlsvWriter.open("test_append_missing.vlsv",MPI_COMM_WORLD,0,MPI_INFO_NULL,true) == true) success = false;
+
+   ParallelReader vlsvReader;
+   if (vlsvReader.open("test_append.vlsv",MPI_COMM_WORLD,0) == false) success = false;
+   for (int a=0; a<N_ARRAYS; ++a) {
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name",arrayName(a)));
+      vector<double> input(N_values,-1.0);
+      if (vlsvReader.readArray("VARIABLE",attribs,myOffset,N_values,reinterpret_cast<char*>(&(input[0]))) == false) success = false;
+      for (uint64_t i=0; i<N_values; ++i) {
+         if (input[i] != value(a,myrank,i)) success = false;
+      }
+   }
+   vlsvReader.close();
+
+   int mySuccess = (success == true) ? 0 : 1;
+   int globalSuccess;
+   MPI_Allreduce(&mySuccess,&globalSuccess,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+   if (myrank == 0) {
+      cout << "Append test : ";
+      if (globalSuccess == 0) cout << "SUCCESS" << endl;
+      else cout << "FAILED" << endl;
+   }
+
+   MPI_Finalize();
+   return globalSuccess;
+}
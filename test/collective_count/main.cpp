@@ -0,0 +1,155 @@
+/** This file is part of VLSV file format.
+ * 
+ *  Copyright 2011-2015 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Counts the number of MPI collectives vlsv::Writer calls per writeArray and commitBatch. 
+ * The counting is done with MPI profiling interface, i.e., the MPI functions 
+ * below replace the ones in MPI library and call the PMPI versions. Compile with
+ * mpic++ -O3 -std=c++0x main.cpp -L../.. -lvlsv
+ * and run with any number of processes.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "../../vlsv_writer.h"
+
+using namespace std;
+
+static size_t collectives = 0;     /**< Number of non-I/O collectives called.*/
+static size_t collectiveWrites = 0; /**< Number of collective file writes called.*/
+
+int MPI_Allreduce(const void* sendbuf,void* recvbuf,int count,MPI_Datatype datatype,MPI_Op op,MPI_Comm comm) {
+   ++collectives;
+   return PMPI_Allreduce(sendbuf,recvbuf,count,datatype,op,comm);
+}
+
+int MPI_Reduce(const void* sendbuf,void* recvbuf,int count,MPI_Datatype datatype,MPI_Op op,int root,MPI_Comm comm) {
+   ++collectives;
+   return PMPI_Reduce(sendbuf,recvbuf,count,datatype,op,root,comm);
+}
+
+int MPI_Bcast(void* buffer,int count,MPI_Datatype datatype,int root,MPI_Comm comm) {
+   ++collectives;
+   return PMPI_Bcast(buffer,count,datatype,root,comm);
+}
+
+int MPI_Exscan(const void* sendbuf,void* recvbuf,int count,MPI_Datatype datatype,MPI_Op op,MPI_Comm comm) {
+   ++collectives;
+   return PMPI_Exscan(sendbuf,recvbuf,count,datatype,op,comm);
+}
+
+int MPI_Gather(const void* sendbuf,int sendcount,MPI_Datatype sendtype,void* recvbuf,int recvcount,
+               MPI_Datatype recvtype,int root,MPI_Comm comm) {
+   ++collectives;
+   return PMPI_Gather(sendbuf,sendcount,sendtype,recvbuf,recvcount,recvtype,root,comm);
+}
+
+int MPI_Scatter(const void* sendbuf,int sendcount,MPI_Datatype sendtype,void* recvbuf,int recvcount,
+                MPI_Datatype recvtype,int root,MPI_Comm comm) {
+   ++collectives;
+   return PMPI_Scatter(sendbuf,sendcount,sendtype,recvbuf,recvcount,recvtype,root,comm);
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+   ++collectives;
+   return PMPI_Barrier(comm);
+}
+
+int MPI_File_write_at_all(MPI_File fh,MPI_Offset offset,const void* buf,int count,MPI_Datatype datatype,MPI_Status* status) {
+   ++collectiveWrites;
+   return PMPI_File_write_at_all(fh,offset,buf,count,datatype,status);
+}
+
+int main(int argn,char* args[]) {
+   int rvalue = 0;
+   int myrank,processes;
+   MPI_Init(&argn,&args);
+   MPI_Comm_rank(MPI_COMM_WORLD,&myrank);
+   MPI_Comm_size(MPI_COMM_WORLD,&processes);
+
+   // Maximum number of collectives allowed per writeArray call:
+   const size_t maxCollectives = 4;
+   const int N_arrays = 20;
+   
+   const size_t elements = 1000 + myrank;
+   vector<double> array(elements);
+   for (size_t i=0; i<elements; ++i) array[i] = i;
+
+   vlsv::Writer vlsvWriter;
+   if (vlsvWriter.open("test_file.vlsv",MPI_COMM_WORLD,0) == false) {
+      cerr << "Failed to open output file" << endl;
+      MPI_Finalize();
+      return 1;
+   }
+
+   map<string,string> attribs;
+   for (int i=0; i<N_arrays; ++i) {
+      attribs["name"] = "array";
+      collectives = 0;
+      collectiveWrites = 0;
+      if (vlsvWriter.writeArray("VARIABLE",attribs,elements,1,&(array[0])) == false) rvalue = 1;
+      
+      if (collectives > maxCollectives || collectiveWrites != 1) {
+         if (myrank == 0) {
+            cerr << "writeArray called " << collectives << " collectives and " << collectiveWrites;
+            cerr << " collective writes, expected at most " << maxCollectives << " and exactly 1" << endl;
+         }
+         rvalue = 1;
+      }
+   }
+   if (myrank == 0) {
+      cout << "Collectives per writeArray  : " << collectives << endl;
+      cout << "Collective writes per array : " << collectiveWrites << endl;
+   }
+
+   // Write the same arrays in batch mode. All arrays should be 
+   // written with the same number of collectives as a single array:
+   collectives = 0;
+   collectiveWrites = 0;
+   if (vlsvWriter.beginBatch() == false) rvalue = 1;
+   for (int i=0; i<N_arrays; ++i) {
+      attribs["name"] = "batch_array";
+      if (vlsvWriter.writeArray("VARIABLE",attribs,elements,1,&(array[0])) == false) rvalue = 1;
+   }
+   if (collectives != 0 || collectiveWrites != 0) {
+      if (myrank == 0) cerr << "writeArray called collectives in batch mode" << endl;
+      rvalue = 1;
+   }
+   if (vlsvWriter.commitBatch() == false) rvalue = 1;
+   if (collectives > maxCollectives || collectiveWrites != 1) {
+      if (myrank == 0) {
+         cerr << "commitBatch called " << collectives << " collectives and " << collectiveWrites;
+         cerr << " collective writes, expected at most " << maxCollectives << " and exactly 1" << endl;
+      }
+      rvalue = 1;
+   }
+   if (myrank == 0) {
+      cout << "Collectives per batch       : " << collectives << endl;
+      cout << "Collective writes per batch : " << collectiveWrites << endl;
+   }
+   vlsvWriter.close();
+
+   if (myrank == 0) {
+      if (rvalue == 0) cout << "Collective count test : SUCCESS" << endl;
+      else cout << "Collective count test : FAILED" << endl;
+   }
+   MPI_Finalize();
+   return rvalue;
+}
@@ -0,0 +1,187 @@
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <list>
+#include <map>
+#include <cmath>
+#include <vector>
+
+#include "../../vlsv_common.h"
+#include "../../vlsv_writer.h"
+#include "../../vlsv_reader_parallel.h"
+
+using namespace std;
+using namespace vlsv;
+
+/** Value of array element i, smooth data compresses well after byte shuffle.*/
+double value(const size_t& i) {
+   return sin(1.0e-4*i);
+}
+
+bool allSucceeded(const bool& success) {
+   int result = 0;
+   if (success == false) result = 1;
+   int globalResult;
+   MPI_Allreduce(&result,&globalResult,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+   return globalResult == 0;
+}
+
+bool write(const int& myrank,const size_t& elements,double& ratio) {
+   bool success = true;
+   double* array = new double[elements];
+   for (size_t i=0; i<elements; ++i) array[i] = value(myrank*elements+i);
+
+   Writer vlsvWriter;
+   if (vlsvWriter.open("test_compression.vlsv",MPI_COMM_WORLD,0) == false) {
+      delete [] array; return false;
+   }
+   vlsvWriter.setChecksums(true);
+   vlsvWriter.setStatistics(true);
+   if (vlsvWriter.setCompression(compression::ZLIB,64*1024) == false) {
+      cerr << "zlib compression is not supported by this build" << endl;
+      success = false;
+   }
+
+   map<string,string> attribs;
+   attribs["name"] = "compressed";
+   if (vlsvWriter.writeArray("ARRAY",attribs,elements,1,array) == false) success = false;
+   if (vlsvWriter.setPrecision(16,true) == false) success = false;
+   attribs["name"] = "lossy";
+   if (vlsvWriter.writeArray("ARRAY",attribs,elements,1,array) == false) success = false;
+   if (vlsvWriter.setPrecision(-1) == false) success = false;
+   if (vlsvWriter.setCompression(compression::NONE) == false) success = false;
+   attribs["name"] = "uncompressed";
+   if (vlsvWriter.writeArray("ARRAY",attribs,elements,1,array) == false) success = false;
+   if (vlsvWriter.close() == false) success = false;
+   delete [] array; array = NULL;
+
+   // Compare array sizes in file:
+   if (myrank == 0) {
+      Reader vlsvReader;
+      if (vlsvReader.open("test_compression.vlsv") == false) success = false;
+      list<pair<string,string> > xmlAttribs;
+      map<string,string> attribsOut;
+      xmlAttribs.push_back(make_pair("name","compressed"));
+      if (vlsvReader.getArrayAttributes("ARRAY",xmlAttribs,attribsOut) == false) success = false;
+      // Compressed array is the first array in file, i.e., it starts right after the header:
+      const double compressedStart = 16.0;
+      const double chunkIndex = atof(attribsOut["chunkindex"].c_str());
+      ratio = 0.0;
+      if (chunkIndex > 0.0) ratio = 8.0*atof(attribsOut["arraysize"].c_str()) / (chunkIndex-compressedStart);
+
+      // Statistics are calculated from the uncompressed data:
+      if (attribsOut["count"] != attribsOut["arraysize"] || atof(attribsOut["min"].c_str()) < -1.0 
+          || atof(attribsOut["max"].c_str()) > 1.0 || atof(attribsOut["max"].c_str()) <= atof(attribsOut["min"].c_str())) {
+         cerr << "compressed array has invalid statistics" << endl;
+         success = false;
+      }
+      vlsvReader.close();
+   }
+   return allSucceeded(success);
+}
+
+bool read(const int& myrank,const int& N_processes,const size_t& elements) {
+   bool success = true;
+
+   // Master reads a part of the array that starts and ends in the middle of chunks:
+   if (myrank == 0) {
+      Reader vlsvReader;
+      if (vlsvReader.open("test_compression.vlsv") == false) success = false;
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","compressed"));
+      const size_t begin = elements/3;
+      const size_t amount = (N_processes*elements)/2;
+      double* array = NULL;
+      if (vlsvReader.read("ARRAY",attribs,begin,amount,array) == false) success = false;
+      for (size_t i=0; i<amount && array != NULL; ++i) {
+         if (array[i] != value(begin+i)) {
+            cerr << "serial read: element " << begin+i << " has value " << array[i] << endl;
+            success = false; break;
+         }
+      }
+      delete [] array; array = NULL;
+      vlsvReader.close();
+   }
+
+   // Lossy array must be within its error bound:
+   if (myrank == 0) {
+      Reader vlsvReader;
+      if (vlsvReader.open("test_compression.vlsv") == false) success = false;
+      list<pair<string,string> > attribs;
+      attribs.push_back(make_pair("name","lossy"));
+      map<string,string> attribsOut;
+      if (vlsvReader.getArrayAttributes("ARRAY",attribs,attribsOut) == false) success = false;
+      if (attribsOut["datasize"] != "4" || attribsOut["mantissabits"] != "16") {
+         cerr << "lossy array has invalid attributes" << endl;
+         success = false;
+      }
+      double* array = NULL;
+      if (vlsvReader.read("ARRAY",attribs,0,N_processes*elements,array) == false) success = false;
+      for (size_t i=0; i<N_processes*elements && array != NULL; ++i) {
+         if (fabs(array[i]-value(i)) > pow(2.0,-17)*fabs(value(i))) {
+            cerr << "lossy read: element " << i << " has value " << array[i] << endl;
+            success = false; break;
+         }
+      }
+      delete [] array; array = NULL;
+      vlsvReader.close();
+   }
+
+   // All processes read their own data in two multi-read units:
+   ParallelReader vlsvReader;
+   if (vlsvReader.open("test_compression.vlsv",MPI_COMM_WORLD,0) == false) return false;
+   uint64_t arraysVerified;
+   vector<string> failedArrays;
+   if (vlsvReader.verifyArrays(arraysVerified,failedArrays) == false || arraysVerified != 3) {
+      if (myrank == 0) cerr << "checksums of " << failedArrays.size() << "/" << arraysVerified << " arrays do not match" << endl;
+      success = false;
+   }
+   vlsvReader.setVerifyChecksums(true);
+   double* array = new double[elements];
+   list<pair<string,string> > attribs;
+   attribs.push_back(make_pair("name","compressed"));
+   if (vlsvReader.startMultiread("ARRAY",attribs) == false) success = false;
+   if (vlsvReader.addMultireadUnit(reinterpret_cast<char*>(array),elements/2) == false) success = false;
+   if (vlsvReader.addMultireadUnit(reinterpret_cast<char*>(array+elements/2),elements-elements/2) == false) success = false;
+   if (vlsvReader.endMultiread(myrank*elements) == false) success = false;
+   for (size_t i=0; i<elements; ++i) {
+      if (array[i] != value(myrank*elements+i)) {
+         stringstream ss;
+         ss << "P#" << myrank << " multi-read: element " << i << " has value " << array[i] << endl;
+         cerr << ss.str();
+         success = false; break;
+      }
+   }
+   delete [] array; array = NULL;
+   vlsvReader.close();
+   return allSucceeded(success);
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myrank,N_processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myrank);
+   MPI_Comm_size(MPI_COMM_WORLD,&N_processes);
+
+   size_t elements = 100000;
+   if (argn > 1) elements = atol(args[1]);
+
+   double ratio = 0.0;
+   const bool writeSuccess = write(myrank,elements,ratio);
+   bool readSuccess = false;
+   if (writeSuccess == true) readSuccess = read(myrank,N_processes,elements);
+
+   if (myrank == 0) {
+      cout << "Compression ratio : " << ratio << endl;
+      cout << "Write test        : ";
+      if (writeSuccess == true) cout << "SUCCESS" << endl;
+      else cout << "FAILED" << endl;
+      cout << "Read test         : ";
+      if (readSuccess == true) cout << "SUCCESS" << endl;
+      else cout << "FAILED" << endl;
+   }
+
+   MPI_Finalize();
+   if (writeSuccess == false || readSuccess == false) return 1;
+   return 0;
+}
@@ -0,0 +1,99 @@
+/** This file is part of VLSV file format.
+ * 
+ *  Copyright 2011-2015 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Tests writeWithDistributedReduction. The same array is reduced over all processes 
+ * with writeWithReduction and writeWithDistributedReduction, and the results read 
+ * back from the file are compared. The array size is not divisible by the number of 
+ * processes unless only one process is used. Reductions in batch mode must fail. 
+ * Compile with
+ * mpic++ -O3 -std=c++0x main.cpp -L../.. -lvlsv -lz
+ * and run with any number of processes.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../../vlsv_writer.h"
+#include "../../vlsv_reader.h"
+
+using namespace std;
+using namespace vlsv;
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myrank,N_processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myrank);
+   MPI_Comm_size(MPI_COMM_WORLD,&N_processes);
+   bool success = true;
+
+   const uint64_t N_values = 1000*N_processes + 7;
+   vector<double> data(N_values);
+   for (uint64_t i=0; i<N_values; ++i) data[i] = myrank*1.0e3 + i;
+
+   Writer vlsvWriter;
+   if (vlsvWriter.open("test_distributed_reduction.vlsv",MPI_COMM_WORLD,0) == false) success = false;
+   map<string,string> attribs;
+   attribs["name"] = "reduced";
+   if (vlsvWriter.writeWithReduction("VARIABLE",attribs,N_values,&(data[0]),MPI_SUM) == false) success = false;
+   attribs["name"] = "distributed";
+   if (vlsvWriter.writeWithDistributedReduction("VARIABLE",attribs,N_values,&(data[0]),MPI_SUM) == false) success = false;
+
+   // Reductions are not queued in batch mode:
+   if (vlsvWriter.beginBatch() == false) success = false;
+   attribs["name"] = "batch";
+   if (vlsvWriter.writeWithReduction("VARIABLE",attribs,N_values,&(data[0]),MPI_SUM) == true) success = false;
+   if (vlsvWriter.writeWithDistributedReduction("VARIABLE",attribs,N_values,&(data[0]),MPI_SUM) == true) success = false;
+   if (vlsvWriter.commitBatch() == false) success = false;
+   if (vlsvWriter.close() == false) success = false;
+
+   // Master process reads both results and compares them to the expected sum:
+   if (myrank == 0) {
+      Reader vlsvReader;
+      if (vlsvReader.open("test_distributed_reduction.vlsv") == false) success = false;
+      list<pair<string,string> > readAttribs;
+      readAttribs.push_back(make_pair("name","reduced"));
+      vector<double> reduced(N_values,-1.0);
+      if (vlsvReader.readArray("VARIABLE",readAttribs,0,1,reinterpret_cast<char*>(&(reduced[0]))) == false) success = false;
+
+      readAttribs.clear();
+      readAttribs.push_back(make_pair("name","distributed"));
+      vector<double> distributed(N_values,-1.0);
+      if (vlsvReader.readArray("VARIABLE",readAttribs,0,N_values,reinterpret_cast<char*>(&(distributed[0]))) == false) success = false;
+      vlsvReader.close();
+
+      for (uint64_t i=0; i<N_values; ++i) {
+         const double expected = 1.0e3*N_processes*(N_processes-1)/2 + N_processes*i;
+         if (reduced[i] != expected || distributed[i] != reduced[i]) success = false;
+      }
+   }
+
+   int mySuccess = (success == true) ? 0 : 1;
+   int globalSuccess;
+   MPI_Allreduce(&mySuccess,&globalSuccess,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+   if (myrank == 0) {
+      cout << "Distributed reduction test : ";
+      if (globalSuccess == 0) cout << "SUCCESS" << endl;
+      else cout << "FAILED" << endl;
+   }
+
+   MPI_Finalize();
+   return globalSuccess;
+}
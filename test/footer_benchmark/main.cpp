@@ -0,0 +1,104 @@
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+#include "../../muxml.h"
+
+using namespace std;
+
+double wallTime() {
+   timeval t;
+   gettimeofday(&t,NULL);
+   return t.tv_sec + 1.0e-6*t.tv_usec;
+}
+
+/** Callback that copies serialized footer chunks to a string.*/
+bool collect(const char* data,const size_t& bytes,void* userData) {
+   reinterpret_cast<string*>(userData)->append(data,bytes);
+   return true;
+}
+
+/** Callback that only counts bytes, which measures the time spent in serialization.*/
+bool count(const char* data,const size_t& bytes,void* userData) {
+   *reinterpret_cast<size_t*>(userData) += bytes;
+   return true;
+}
+
+/** Build a footer that looks like a footer of a VLSV file with the given number of arrays.*/
+void buildFooter(muxml::MuXML& xml,const size_t& N_arrays) {
+   muxml::XMLNode* vlsv = xml.addNode(xml.getRoot(),"VLSV","");
+   size_t offset = 16;
+   for (size_t i=0; i<N_arrays; ++i) {
+      stringstream ss;
+      ss << "domain_" << i;
+      muxml::XMLNode* node = xml.addNode(vlsv,"MESH_DOMAIN_SIZES",offset);
+      xml.addAttribute(node,"mesh",ss.str());
+      xml.addAttribute(node,"arraysize",i%1000+1);
+      xml.addAttribute(node,"vectorsize",2);
+      xml.addAttribute(node,"datatype","uint");
+      xml.addAttribute(node,"datasize",8);
+      offset += (i%1000+1)*16;
+   }
+}
+
+int main(int argn,char* args[]) {
+   size_t maxArrays = 1000000;
+   if (argn > 1) maxArrays = atol(args[1]);
+
+   bool success = true;
+   vector<char> buffer;
+   cout << "arrays\tbytes\tprint (s)\tserialize (s)\tread (s)\tparse (s)" << endl;
+   for (size_t N_arrays=1000; N_arrays<=maxArrays; N_arrays*=10) {
+      muxml::MuXML xml;
+      buildFooter(xml,N_arrays);
+
+      // Old method, print to a stringstream and copy its contents to a string:
+      double t_start = wallTime();
+      stringstream footerStream;
+      xml.print(footerStream);
+      string footerString = footerStream.str();
+      const double t_print = wallTime() - t_start;
+
+      // Streaming serializer with a reused buffer:
+      size_t bytes = 0;
+      t_start = wallTime();
+      xml.serialize(buffer,4*1024*1024,count,&bytes);
+      const double t_serialize = wallTime() - t_start;
+
+      // Check that output is identical:
+      string serialized;
+      xml.serialize(buffer,4096,collect,&serialized);
+      if (serialized != footerString || bytes != footerString.size()) success = false;
+
+      // Old character by character stream reader:
+      t_start = wallTime();
+      muxml::MuXML xmlRead;
+      stringstream inputStream(footerString);
+      xmlRead.read(inputStream);
+      const double t_read = wallTime() - t_start;
+
+      // Buffer-based parser:
+      t_start = wallTime();
+      muxml::MuXML xmlParsed;
+      if (xmlParsed.parse(footerString.data(),footerString.size()) == false) success = false;
+      const double t_parse = wallTime() - t_start;
+
+      // Check that both trees are identical to the original tree:
+      stringstream readStream;
+      stringstream parsedStream;
+      xmlRead.print(readStream);
+      xmlParsed.print(parsedStream);
+      if (readStream.str() != footerString || parsedStream.str() != footerString) success = false;
+
+      cout << N_arrays << '\t' << bytes << '\t' << t_print << '\t' << t_serialize << '\t' << t_read << '\t' << t_parse << endl;
+   }
+
+   cout << "Footer benchmark : ";
+   if (success == true) cout << "SUCCESS" << endl;
+   else cout << "FAILED" << endl;
+   if (success == false) return 1;
+   return 0;
+}
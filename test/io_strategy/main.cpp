@@ -0,0 +1,134 @@
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "../../vlsv_common.h"
+#include "../../vlsv_writer.h"
+#include "../../vlsv_reader_parallel.h"
+
+using namespace std;
+using namespace vlsv;
+
+/** Benchmark of the methods used to transfer fragmented multi-write and multi-read
+ * units to MPI. Each process writes and reads a fixed amount of data as units of
+ * varying size. Units are separated by gaps in memory so that they are not merged.
+ * The crossover points between packing and derived datatypes are used to tune
+ * iostrategy::AUTO.*/
+
+const int N_STRATEGIES = 4;
+const iostrategy::type strategies[N_STRATEGIES] = {iostrategy::PACK,iostrategy::INDEXED,iostrategy::STRUCT,iostrategy::AUTO};
+const char* strategyNames[N_STRATEGIES] = {"pack","indexed","struct","auto"};
+
+double maxTime(const double& t) {
+   double result;
+   MPI_Allreduce(const_cast<double*>(&t),&result,1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+   return result;
+}
+
+bool writeUnits(Writer& vlsvWriter,const string& name,vector<double>& data,const size_t& unitValues,const size_t& N_units,double& t) {
+   bool success = true;
+   map<string,string> attribs;
+   attribs["name"] = name;
+   MPI_Barrier(MPI_COMM_WORLD);
+   const double t_start = MPI_Wtime();
+   if (vlsvWriter.startMultiwrite<double>(N_units*unitValues,1) == false) success = false;
+   for (size_t u=0; u<N_units; ++u) {
+      if (vlsvWriter.addMultiwriteUnit(&(data[2*u*unitValues]),unitValues) == false) success = false;
+   }
+   if (vlsvWriter.endMultiwrite("VARIABLE",attribs) == false) success = false;
+   t = maxTime(MPI_Wtime()-t_start);
+   return success;
+}
+
+bool readUnits(ParallelReader& vlsvReader,const string& name,vector<double>& data,const size_t& unitValues,
+               const size_t& N_units,const int& myrank,double& t) {
+   bool success = true;
+   list<pair<string,string> > attribs;
+   attribs.push_back(make_pair("name",name));
+   MPI_Barrier(MPI_COMM_WORLD);
+   const double t_start = MPI_Wtime();
+   if (vlsvReader.startMultiread("VARIABLE",attribs) == false) success = false;
+   for (size_t u=0; u<N_units; ++u) {
+      if (vlsvReader.addMultireadUnit(reinterpret_cast<char*>(&(data[2*u*unitValues])),unitValues) == false) success = false;
+   }
+   if (vlsvReader.endMultiread(myrank*N_units*unitValues) == false) success = false;
+   t = maxTime(MPI_Wtime()-t_start);
+   return success;
+}
+
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myrank,N_processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myrank);
+   MPI_Comm_size(MPI_COMM_WORLD,&N_processes);
+
+   // Number of bytes written by each process:
+   size_t bytesPerProcess = 16*1024*1024;
+   if (argn > 1) bytesPerProcess = atol(args[1]);
+   const size_t N_values = bytesPerProcess/sizeof(double);
+
+   // Every other unit-sized slot of data is written:
+   vector<double> data(2*N_values);
+   vector<double> input(2*N_values);
+   bool success = true;
+
+   if (myrank == 0) {
+      cout << "Seconds to write / read " << bytesPerProcess << " bytes per process on " << N_processes << " processes" << endl;
+      cout << setw(10) << "unit bytes" << setw(10) << "units";
+      for (int s=0; s<N_STRATEGIES; ++s) {
+         cout << setw(10) << string(strategyNames[s])+" w" << setw(10) << string(strategyNames[s])+" r";
+      }
+      cout << endl;
+   }
+
+   for (size_t unitBytes=8; unitBytes<=1024*1024 && unitBytes<=bytesPerProcess; unitBytes*=4) {
+      const size_t unitValues = unitBytes/sizeof(double);
+      const size_t N_units = N_values/unitValues;
+      for (size_t u=0; u<N_units; ++u) {
+         for (size_t i=0; i<unitValues; ++i) data[2*u*unitValues+i] = (myrank*N_units+u)*unitValues+i;
+      }
+
+      double writeTimes[N_STRATEGIES];
+      double readTimes[N_STRATEGIES];
+      for (int s=0; s<N_STRATEGIES; ++s) {
+         Writer vlsvWriter;
+         if (vlsvWriter.open("test_io_strategy.vlsv",MPI_COMM_WORLD,0) == false) success = false;
+         vlsvWriter.setIOStrategy(strategies[s]);
+         if (writeUnits(vlsvWriter,strategyNames[s],data,unitValues,N_units,writeTimes[s]) == false) success = false;
+         if (vlsvWriter.close() == false) success = false;
+
+         ParallelReader vlsvReader;
+         if (vlsvReader.open("test_io_strategy.vlsv",MPI_COMM_WORLD,0) == false) success = false;
+         vlsvReader.setIOStrategy(strategies[s]);
+         input.assign(input.size(),-1.0);
+         if (readUnits(vlsvReader,strategyNames[s],input,unitValues,N_units,myrank,readTimes[s]) == false) success = false;
+         vlsvReader.close();
+         for (size_t u=0; u<N_units; ++u) {
+            for (size_t i=0; i<unitValues; ++i) {
+               if (input[2*u*unitValues+i] != data[2*u*unitValues+i]) success = false;
+            }
+         }
+      }
+
+      if (myrank == 0) {
+         cout << setw(10) << unitBytes << setw(10) << N_units;
+         for (int s=0; s<N_STRATEGIES; ++s) cout << setw(10) << setprecision(3) << writeTimes[s] << setw(10) << readTimes[s];
+         cout << endl;
+      }
+   }
+
+   int mySuccess = (success == true) ? 0 : 1;
+   int globalSuccess;
+   MPI_Allreduce(&mySuccess,&globalSuccess,1,MPI_INT,MPI_MAX,MPI_COMM_WORLD);
+   if (myrank == 0) {
+      cout << "I/O strategy test : ";
+      if (globalSuccess == 0) cout << "SUCCESS" << endl;
+      else cout << "FAILED" << endl;
+   }
+
+   MPI_Finalize();
+   return globalSuccess;
+}
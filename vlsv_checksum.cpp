@@ -0,0 +1,205 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __SSE4_2__
+   #include <nmmintrin.h>
+#endif
+
+#include "vlsv_checksum.h"
+
+using namespace std;
+
+namespace vlsv {
+
+   /** Reversed CRC32C (Castagnoli) polynomial.*/
+   static const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+   #ifndef __SSE4_2__
+   /** Lookup tables for slicing-by-8 CRC32C computation.*/
+   struct CRC32CTables {
+      uint32_t table[8][256];
+
+      CRC32CTables() {
+         for (uint32_t i=0; i<256; ++i) {
+            uint32_t crc = i;
+            for (int j=0; j<8; ++j) crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0 - (crc & 1)));
+            table[0][i] = crc;
+         }
+         for (uint32_t i=0; i<256; ++i) {
+            for (int t=1; t<8; ++t) table[t][i] = (table[t-1][i] >> 8) ^ table[0][table[t-1][i] & 0xFF];
+         }
+      }
+   };
+
+   static const CRC32CTables crc32cTables;
+   #endif
+
+   /** Update a CRC32C checksum with the given data. Checksum of data that is
+    * split into several pieces can be computed by passing the checksum of
+    * previous pieces as the first parameter.
+    * @param crc Checksum of previous data, zero if there is no previous data.
+    * @param data Data.
+    * @param bytes Number of bytes in data.
+    * @return Checksum of previous data followed by the given data.*/
+   uint32_t crc32c(const uint32_t& crc,const char* data,const uint64_t& bytes) {
+      const unsigned char* ptr = reinterpret_cast<const unsigned char*>(data);
+      const unsigned char* end = ptr + bytes;
+      #ifdef __SSE4_2__
+         uint64_t value = ~crc & 0xFFFFFFFF;
+         for (; ptr+8<=end; ptr+=8) {
+            uint64_t word;
+            memcpy(&word,ptr,sizeof(uint64_t));
+            value = _mm_crc32_u64(value,word);
+         }
+         uint32_t value32 = value;
+         for (; ptr<end; ++ptr) value32 = _mm_crc32_u8(value32,*ptr);
+         return ~value32;
+      #else
+         const uint32_t (*table)[256] = crc32cTables.table;
+         uint32_t value = ~crc;
+         for (; ptr+8<=end; ptr+=8) {
+            const uint32_t low  = value ^ (ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | (static_cast<uint32_t>(ptr[3]) << 24));
+            const uint32_t high = ptr[4] | (ptr[5] << 8) | (ptr[6] << 16) | (static_cast<uint32_t>(ptr[7]) << 24);
+            value = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24]
+                  ^ table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+         }
+         for (; ptr<end; ++ptr) value = (value >> 8) ^ table[0][(value ^ *ptr) & 0xFF];
+         return ~value;
+      #endif
+   }
+
+   /** Multiply a vector by a 32x32 matrix over GF(2).*/
+   static uint32_t gf2MatrixTimes(const uint32_t* matrix,uint32_t vector) {
+      uint32_t sum = 0;
+      while (vector != 0) {
+         if ((vector & 1) != 0) sum ^= *matrix;
+         vector >>= 1;
+         ++matrix;
+      }
+      return sum;
+   }
+
+   /** Square a 32x32 matrix over GF(2).*/
+   static void gf2MatrixSquare(uint32_t* square,const uint32_t* matrix) {
+      for (int n=0; n<32; ++n) square[n] = gf2MatrixTimes(matrix,matrix[n]);
+   }
+
+   /** Combine CRC32C checksums of two consecutive pieces of data, i.e.,
+    * calculate the checksum of the data without having the data. The number
+    * of operations is logarithmic in the length of the second piece.
+    * @param crc1 Checksum of the first piece.
+    * @param crc2 Checksum of the second piece.
+    * @param bytes2 Number of bytes in the second piece.
+    * @return Checksum of the first piece followed by the second piece.*/
+   uint32_t crc32cCombine(const uint32_t& crc1,const uint32_t& crc2,const uint64_t& bytes2) {
+      if (bytes2 == 0) return crc1;
+
+      // Operator for a single zero bit:
+      uint32_t odd[32];
+      uint32_t even[32];
+      odd[0] = CRC32C_POLYNOMIAL;
+      uint32_t row = 1;
+      for (int n=1; n<32; ++n) {
+         odd[n] = row;
+         row <<= 1;
+      }
+
+      // Operators for two and four zero bits:
+      gf2MatrixSquare(even,odd);
+      gf2MatrixSquare(odd,even);
+
+      // Apply zero bytes to crc1, the first square gives the operator for a single zero byte:
+      uint32_t crc = crc1;
+      uint64_t bytes = bytes2;
+      do {
+         gf2MatrixSquare(even,odd);
+         if ((bytes & 1) != 0) crc = gf2MatrixTimes(even,crc);
+         bytes >>= 1;
+         if (bytes == 0) break;
+
+         gf2MatrixSquare(odd,even);
+         if ((bytes & 1) != 0) crc = gf2MatrixTimes(odd,crc);
+         bytes >>= 1;
+      } while (bytes != 0);
+      return crc ^ crc2;
+   }
+
+   /** Multiplier used in hash64, the 64-bit golden ratio.*/
+   static const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+   /** Mix an eight-byte word into a hash with a multiply-xorshift step.
+    * @param value Hash of the previous words.
+    * @param word Next word.
+    * @return Hash of the previous words followed by the given word.*/
+   static inline uint64_t hashWord(const uint64_t& value,const uint64_t& word) {
+      const uint64_t mixed = (value ^ word) * HASH_MULTIPLIER;
+      return mixed ^ (mixed >> 29);
+   }
+
+   /** Constructor for Hash64, initializes the hash of empty data.*/
+   Hash64::Hash64(): value(0),word(0),bytes(0) { }
+
+   /** Update a 64-bit hash with the given data. Data is processed eight bytes at a 
+    * time with a multiply-xorshift step, which is fast enough to hash arrays while 
+    * they are written. Bytes that do not fill a whole word are kept in the hash 
+    * state until the next call, thus the hash does not depend on how the data is 
+    * split between calls. The hash is not cryptographic, but collisions of distinct 
+    * data are extremely unlikely. It is used to detect arrays that are identical 
+    * to arrays in earlier files, see Writer::setHistory.
+    * @param hash Hash of previous data, updated to the hash of previous data followed by the given data.
+    * @param data Data.
+    * @param bytes Number of bytes in data.*/
+   void hash64(Hash64& hash,const char* data,const uint64_t& bytes) {
+      const char* end = data + bytes;
+      const uint64_t pending = hash.bytes % sizeof(uint64_t);
+      hash.bytes += bytes;
+
+      // Complete the word that was left partial by the previous call:
+      if (pending > 0) {
+         const uint64_t copied = min<uint64_t>(sizeof(uint64_t)-pending,bytes);
+         memcpy(reinterpret_cast<char*>(&(hash.word))+pending,data,copied);
+         data += copied;
+         if (pending+copied < sizeof(uint64_t)) return;
+         hash.value = hashWord(hash.value,hash.word);
+         hash.word = 0;
+      }
+      for (; end-data >= static_cast<ptrdiff_t>(sizeof(uint64_t)); data+=sizeof(uint64_t)) {
+         uint64_t word;
+         memcpy(&word,data,sizeof(uint64_t));
+         hash.value = hashWord(hash.value,word);
+      }
+      if (data < end) memcpy(&(hash.word),data,end-data);
+   }
+
+   /** Get the value of a 64-bit hash, see hash64. The remaining partial word and 
+    * the number of bytes are mixed in, and the value is finalized.
+    * @param hash Hash state.
+    * @return Hash of all data given to hash64.*/
+   uint64_t hash64Final(const Hash64& hash) {
+      uint64_t value = hash.value;
+      if (hash.bytes % sizeof(uint64_t) != 0) value = hashWord(value,hash.word);
+      value = (value ^ hash.bytes) * HASH_MULTIPLIER;
+      return value ^ (value >> 32);
+   }
+
+} // namespace vlsv
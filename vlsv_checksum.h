@@ -0,0 +1,55 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VLSV_CHECKSUM_H
+#define VLSV_CHECKSUM_H
+
+#include <stdint.h>
+
+/** Arrays written with checksums enabled, see Writer::setChecksums, have the
+ * following additional attribute in the footer:
+ *
+ * crc32c (uint)                 CRC32C (Castagnoli) checksum of all bytes stored for the array,
+ *                               i.e., of the array data, and of the chunk table of a compressed array.
+ *
+ * Each process computes the checksum of its own contribution, and the checksums are combined
+ * in rank order, thus the stored value does not depend on the number of processes. If VLSV
+ * is compiled with SSE 4.2 instructions enabled (e.g. -msse4.2) the checksum is computed with
+ * the hardware CRC32C instruction.
+ */
+
+namespace vlsv {
+
+   uint32_t crc32c(const uint32_t& crc,const char* data,const uint64_t& bytes);
+   uint32_t crc32cCombine(const uint32_t& crc1,const uint32_t& crc2,const uint64_t& bytes2);
+
+   /** State of a 64-bit hash that is computed from data given in pieces, see hash64.*/
+   struct Hash64 {
+      uint64_t value;                        /**< Hash of the whole eight-byte words processed so far.*/
+      uint64_t word;                         /**< Bytes following the last whole word, not yet hashed.*/
+      uint64_t bytes;                        /**< Number of bytes processed so far.*/
+
+      Hash64();
+   };
+
+   void hash64(Hash64& hash,const char* data,const uint64_t& bytes);
+   uint64_t hash64Final(const Hash64& hash);
+
+} // namespace vlsv
+
+#endif
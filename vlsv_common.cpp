@@ -18,8 +18,10 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <map>
 #include <sstream>
 
+#include "muxml.h"
 #include "vlsv_common.h"
 
 using namespace std;
@@ -45,6 +47,26 @@ namespace vlsv {
       else return datatype::ENDIANNESS_BIG;
    }
 
+   const std::string& getCompression(compression::type method) {
+      switch (method) {
+       case compression::NONE:
+         return compression::STRING_NONE;
+         break;
+       case compression::ZLIB:
+         return compression::STRING_ZLIB;
+         break;
+       default:
+         return compression::STRING_UNKNOWN;
+         break;
+      }
+   }
+
+   compression::type getCompression(const std::string& s) {
+      if (s == compression::STRING_NONE) return compression::NONE;
+      else if (s == compression::STRING_ZLIB) return compression::ZLIB;
+      return compression::UNKNOWN;
+   }
+
    const std::string& getMeshGeometry(geometry::type geom) {
       switch (geom) {
        case geometry::UNKNOWN:
@@ -104,6 +126,93 @@ namespace vlsv {
       else return datatype::UNKNOWN;
    }
 
+   /** Get the file offset of the binary footer index from the file header, see footerindex.
+    * @param header First 16 bytes of a VLSV file.
+    * @return Offset of the footer index, zero if the file has no index.*/
+   uint64_t getFooterIndexOffset(const char* header) {
+      const unsigned char* ptr = reinterpret_cast<const unsigned char*>(header);
+      uint64_t indexOffset = 0;
+      for (int i=7; i>=1; --i) indexOffset = (indexOffset << 8) | ptr[i];
+      return indexOffset;
+   }
+
+   /** Get the file offset of the previous footer snapshot from a footer snapshot, see footersnapshot.
+    * @param snapshot Footer snapshot.
+    * @return Offset of the XML footer of the previous snapshot, zero if the snapshot is a complete footer.*/
+   uint64_t getPreviousFooterOffset(const muxml::MuXML& snapshot) {
+      const muxml::XMLNode* vlsv = snapshot.find("VLSV");
+      if (vlsv == NULL) return 0;
+      map<string,string>::const_iterator previous = vlsv->attributes.find(footersnapshot::PREVIOUS);
+      if (previous == vlsv->attributes.end()) return 0;
+      return strtoull(previous->second.c_str(),NULL,10);
+   }
+
+   /** Get the name by which a VLSV file refers to another VLSV file, see Writer::setHistory. 
+    * Files in the same directory are referred to without path, so that the files 
+    * can be moved together. Otherwise the name of the referenced file is used as is.
+    * @param fileName Name of the referring file, may include path.
+    * @param referencedFile Name of the referenced file, may include path.
+    * @return Name stored in the referring file.*/
+   std::string getReferenceName(const std::string& fileName,const std::string& referencedFile) {
+      const size_t position = fileName.find_last_of("/");
+      const size_t referencedPosition = referencedFile.find_last_of("/");
+      const string path = (position == string::npos) ? "" : fileName.substr(0,position+1);
+      const string referencedPath = (referencedPosition == string::npos) ? "" : referencedFile.substr(0,referencedPosition+1);
+      if (path != referencedPath) return referencedFile;
+      return referencedFile.substr(referencedPath.size());
+   }
+
+   /** Get the name of a data subfile of a VLSV file written in subfiling mode, 
+    * see Writer::setSubfiles. Extension '.vlsv' of the file name is replaced 
+    * by '.sub' followed by the subfile index, e.g., subfile 3 of 'bulk.vlsv' is 
+    * 'bulk.sub3'. Subfiles are in the same directory as the VLSV file.
+    * @param fileName Name of the VLSV file, may include path.
+    * @param subfile Index of the subfile.
+    * @return Name of the subfile, including the path of the VLSV file.*/
+   std::string getSubfileName(const std::string& fileName,const uint64_t& subfile) {
+      const string suffix = ".vlsv";
+      string base = fileName;
+      if (base.size() >= suffix.size() && base.compare(base.size()-suffix.size(),suffix.size(),suffix) == 0) {
+         base.erase(base.size()-suffix.size());
+      }
+      stringstream ss;
+      ss << base << ".sub" << subfile;
+      return ss.str();
+   }
+
+   /** Merge a chain of footer snapshots into a footer, see footersnapshot. Tags of 
+    * the snapshots are moved to the VLSV element of the footer in the order in which 
+    * they were written, after the tags that are already in the footer.
+    * @param snapshots Snapshots in reverse order of writing, i.e., the newest snapshot first. 
+    * Their tags are removed.
+    * @param footer Footer in which the tags are moved.*/
+   void mergeFooterSnapshots(const std::vector<muxml::MuXML*>& snapshots,muxml::MuXML& footer) {
+      muxml::XMLNode* vlsv = footer.find("VLSV");
+      if (vlsv == NULL) vlsv = footer.addNode(footer.getRoot(),"VLSV","");
+      for (vector<muxml::MuXML*>::const_reverse_iterator s=snapshots.rbegin(); s!=snapshots.rend(); ++s) {
+         muxml::XMLNode* snapshot = (*s)->find("VLSV");
+         if (snapshot == NULL) continue;
+         for (multimap<string,muxml::XMLNode*>::iterator it=snapshot->children.begin(); it!=snapshot->children.end(); ++it) {
+            it->second->parent = vlsv;
+            vlsv->children.insert(vlsv->children.end(),*it);
+         }
+         snapshot->children.clear();
+      }
+   }
+
+   /** Get the name of a VLSV file referred to by another VLSV file, i.e., the inverse 
+    * of getReferenceName. References without path are relative to the directory 
+    * of the referring file.
+    * @param fileName Name of the referring file, may include path.
+    * @param reference Name stored in the referring file.
+    * @return Name of the referenced file.*/
+   std::string resolveReferenceName(const std::string& fileName,const std::string& reference) {
+      if (reference.find_last_of("/") != string::npos) return reference;
+      const size_t position = fileName.find_last_of("/");
+      if (position == string::npos) return reference;
+      return fileName.substr(0,position+1) + reference;
+   }
+
    /** Print the data rate corresponding to given number of bytes and time in human readable format.
     * @param bytes Number of bytes written or read.
     * @param t Time spent in reading or writing bytes in seconds.
@@ -118,4 +227,12 @@ namespace vlsv {
       return s.str();
    }
    
+   /** Store the file offset of the binary footer index in the file header, see footerindex.
+    * @param header First 16 bytes of a VLSV file, bytes 1-7 are modified.
+    * @param indexOffset Offset of the footer index, zero if the file has no index.*/
+   void setFooterIndexOffset(char* header,const uint64_t& indexOffset) {
+      unsigned char* ptr = reinterpret_cast<unsigned char*>(header);
+      for (int i=1; i<8; ++i) ptr[i] = (indexOffset >> (8*(i-1))) & 0xFF;
+   }
+
 } // namespace vlsv
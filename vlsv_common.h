@@ -22,8 +22,16 @@
 #define VLSV_COMMON_H
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace muxml {
+   class MuXML;
+}
 
 namespace vlsv {
 
@@ -58,6 +66,65 @@ namespace vlsv {
       };
    }
    
+   /** Tells how the data of an array has been stored in a file. Compressed arrays are 
+    * split into chunks that are compressed independently, see vlsv_compression.h.
+    * @brief Array compression method.*/
+   namespace compression {
+      enum type {
+         UNKNOWN,                                            /**< @brief Unknown or unsupported compression method.*/
+         NONE,                                               /**< @brief Array is stored uncompressed.*/
+         ZLIB                                                /**< @brief Chunks are byte-shuffled and compressed with zlib.*/
+      };
+
+      const std::string STRING_UNKNOWN = "unknown";          /**< Unknown or unsupported compression method.*/
+      const std::string STRING_NONE = "none";                /**< No compression.*/
+      const std::string STRING_ZLIB = "zlib";                /**< Byte shuffle + zlib compression.*/
+   }
+
+   /** Binary footer index, written by Writer immediately before the XML footer unless 
+    * disabled with Writer::setFooterIndex. Readers that understand the index load the 
+    * footer with a single read and without parsing XML, other readers use the XML footer. 
+    * The file offset of the index is stored in bytes 1-7 of the file header as a 56-bit 
+    * little endian integer, zero if the file has no index, see getFooterIndexOffset. 
+    * The index is valid only if it refers to the footer pointed to by the header.
+    * 
+    * All integers are 64-bit unsigned integers in the byte order of the file:
+    * 
+    * MAGIC                          8 characters "VLSVIDX1".
+    * footer offset                  File offset of the XML footer described by the index.
+    * tags                           Number of tags, i.e., children of the VLSV root element.
+    * attributes                     Total number of attributes.
+    * string bytes                   Size of the string table.
+    * tag table                      TAG_VALUES integers per tag: tag name, tag value, index of the 
+    *                                first attribute, number of attributes, and the numeric values of 
+    *                                the tag value, arraysize, vectorsize, and datasize attributes, and 
+    *                                the datatype (one plus datatype::type, zero if not recognized).
+    * attribute table                ATTRIBUTE_VALUES integers per attribute: name and value.
+    * string table                   Null-terminated strings. Strings are referred to by their 
+    *                                position in the table.
+    * 
+    * Tags are in the order of the XML footer, and attributes of each tag are sorted by name.
+    * @brief Binary footer index.*/
+   namespace footerindex {
+      const char MAGIC[] = "VLSVIDX1";                       /**< Identifies the start of the index.*/
+      const uint64_t HEADER_BYTES = 40;                      /**< Size of magic and counts before the tag table.*/
+      const uint64_t TAG_VALUES = 9;                         /**< Number of integers per tag.*/
+      const uint64_t ATTRIBUTE_VALUES = 2;                   /**< Number of integers per attribute.*/
+   }
+
+   /** Footer snapshots, written by Writer while the file is open if enabled with 
+    * Writer::setFooterInterval. The first snapshot written to a file is a complete footer. 
+    * Each later snapshot only contains the tags added after the previous snapshot, and 
+    * the VLSV root element of the snapshot has attribute PREVIOUS whose value is the file 
+    * offset of the XML footer of the previous snapshot. The complete footer is obtained 
+    * by following the chain of snapshots back to the first one and merging their tags 
+    * in the order they were written, see mergeFooterSnapshots. Snapshots other than the 
+    * first one have no binary index. The footer written when the file is closed is complete.
+    * @brief Incremental footer snapshots.*/
+   namespace footersnapshot {
+      const std::string PREVIOUS = "previous";               /**< Attribute holding the offset of the previous snapshot.*/
+   }
+
    namespace geometry {
       enum type {
 	   UNKNOWN,                                          /**< Mesh has unknown or unsupported coordinate system.*/
@@ -135,6 +202,8 @@ namespace vlsv {
       }
    }
    
+   template<typename T> bool convertArray(T* output,const char* const input,datatype::type dt,int dataSize,
+                                          const uint64_t& N_values,const bool& swapEndianness=false);
    template<typename T> T convertFloat(const char* const ptr);
    template<typename T> T convertInteger(const char* const ptr,const bool& swapEndianness=false);
    template<typename T> void convertValue(T& value,const char* const ptr,datatype::type dt,int dataSize,const bool& swapEndianness=false);
@@ -149,9 +218,18 @@ namespace vlsv {
    template<typename T> std::string getStringDatatype();
    
    std::string getStringDatatype(const vlsv::datatype::type& dt);
+   const std::string& getCompression(compression::type method);
+   compression::type getCompression(const std::string& s);
    const std::string& getMeshGeometry(geometry::type geom);
    geometry::type getMeshGeometry(const std::string& s);
    datatype::type getVLSVDatatype(const std::string& s);
+   uint64_t getFooterIndexOffset(const char* header);
+   uint64_t getPreviousFooterOffset(const muxml::MuXML& snapshot);
+   std::string getReferenceName(const std::string& fileName,const std::string& referencedFile);
+   std::string getSubfileName(const std::string& fileName,const uint64_t& subfile);
+   void mergeFooterSnapshots(const std::vector<muxml::MuXML*>& snapshots,muxml::MuXML& footer);
+   std::string resolveReferenceName(const std::string& fileName,const std::string& reference);
+   void setFooterIndexOffset(char* header,const uint64_t& indexOffset);
    
    // ********************************************* //
    // ***** DEFINITIONS OF TEMPLATE FUNCTIONS ***** //
@@ -281,6 +359,94 @@ namespace vlsv {
       }
    }
    
+   /** Convert an array of values of type S stored in a byte buffer into an array of type T.
+    * Values are loaded with memcpy, which allows the compiler to vectorize the loop regardless 
+    * of the alignment of the input buffer. The input may overlap the output if it does not 
+    * start at a lower address and S is not larger than T, i.e., arrays can be converted in place, 
+    * see Reader::read. Values of the same type are copied as a single block.
+    * @brief Convert an array of basic datatype values to another basic datatype.
+    * @tparam S Basic C/C++ datatype of the values in input buffer.
+    * @tparam T Basic C/C++ datatype of the values in output array.
+    * @param output Array in which the converted values are written.
+    * @param input Buffer containing the values.
+    * @param N_values Number of values in input buffer.
+    * @param swapEndianness If true, endianness of each integer value is swapped before conversion.*/
+   template<typename S,typename T> inline
+   void convertValues(T* output,const char* const input,const uint64_t& N_values,const bool& swapEndianness=false) {
+      if (swapEndianness == true && sizeof(S) > 1) {
+         for (uint64_t i=0; i<N_values; ++i) output[i] = convertInteger<S>(input+i*sizeof(S),true);
+      } else if (std::is_same<S,T>::value == true) {
+         if (reinterpret_cast<const char*>(output) != input) std::memmove(output,input,N_values*sizeof(T));
+      } else {
+         for (uint64_t i=0; i<N_values; ++i) {
+            S value;
+            std::memcpy(&value,input+i*sizeof(S),sizeof(S));
+            output[i] = value;
+         }
+      }
+   }
+
+   /** Convert an array of values in a buffer into datatype given with template parameter T.
+    * This is equivalent to calling convertValue for each value, but the datatype of the buffer 
+    * is resolved only once, and the values are converted with a loop that is specialized for 
+    * the input and output datatypes at compile time. The input may overlap the output as 
+    * explained in convertValues. Note that if vlsv::datatype is vlsv::UNKNOWN the contents of 
+    * buffer are simply byte-copied into output array.
+    * @brief Convert data in buffer to an array of basic datatype values.
+    * @tparam T Basic datatype that the buffer data is converted into.
+    * @param output Array in which the converted values are written.
+    * @param input Buffer containing the values.
+    * @param dt vlsv::datatype of the values in buffer.
+    * @param dataSize Byte size of each value in buffer.
+    * @param N_values Number of values in buffer.
+    * @param swapEndianness If true, endianness of integer datatypes is swapped before
+    * the values are copied to output array.
+    * @return If true, the values were converted. If false, the datatype of the buffer is not supported.*/
+   template<typename T> inline
+   bool convertArray(T* output,const char* const input,datatype::type dt,int dataSize,
+                     const uint64_t& N_values,const bool& swapEndianness) {
+      // Switch according the native datatype of the values in buffer:
+      switch (dt) {
+         case datatype::UNKNOWN:
+            // Unknown datatype, just byte-copy each value in buffer to output:
+            if (dataSize == sizeof(T)) {
+               if (reinterpret_cast<const char*>(output) != input) std::memmove(output,input,N_values*sizeof(T));
+               return true;
+            }
+            if (dataSize > static_cast<int>(sizeof(T))) return false;
+            for (uint64_t i=0; i<N_values; ++i) std::memcpy(output+i,input+i*dataSize,dataSize);
+            return true;
+         case datatype::INT:
+            // Signed integer, switch according to byte size:
+            switch (dataSize) {
+               case sizeof(int8_t):  convertValues<int8_t>(output,input,N_values,swapEndianness);  return true;
+               case sizeof(int16_t): convertValues<int16_t>(output,input,N_values,swapEndianness); return true;
+               case sizeof(int32_t): convertValues<int32_t>(output,input,N_values,swapEndianness); return true;
+               case sizeof(int64_t): convertValues<int64_t>(output,input,N_values,swapEndianness); return true;
+               default: return false;
+            }
+         case datatype::UINT:
+            // Unsigned integer, switch according to byte size:
+            switch (dataSize) {
+               case sizeof(uint8_t):  convertValues<uint8_t>(output,input,N_values,swapEndianness);  return true;
+               case sizeof(uint16_t): convertValues<uint16_t>(output,input,N_values,swapEndianness); return true;
+               case sizeof(uint32_t): convertValues<uint32_t>(output,input,N_values,swapEndianness); return true;
+               case sizeof(uint64_t): convertValues<uint64_t>(output,input,N_values,swapEndianness); return true;
+               default: return false;
+            }
+         case datatype::FLOAT:
+            // Floating point, switch according to byte size:
+            switch (dataSize) {
+               case sizeof(float):       convertValues<float>(output,input,N_values);       return true;
+               case sizeof(double):      convertValues<double>(output,input,N_values);      return true;
+               case sizeof(long double): convertValues<long double>(output,input,N_values); return true;
+               default: return false;
+            }
+         default:
+            return false;
+      }
+   }
+
    template<typename T> inline std::string getStringDatatype() {return "unknown";}
    template<> inline std::string getStringDatatype<bool>() {return "int";}
    template<> inline std::string getStringDatatype<char>() {return "uint";}
@@ -21,6 +21,7 @@
 #include <limits>
 
 #include "mpiconversion.h"
+#include "vlsv_checksum.h"
 #include "vlsv_common.h"
 #include "vlsv_common_mpi.h"
 
@@ -59,9 +60,8 @@ namespace vlsv {
       int32_t globalSuccess = 0;
       if (myStatus == false) mySuccess = 1;
 
-      // Sum mySuccess values to master process and broadcast to all processes:
-      MPI_Reduce(&mySuccess,&globalSuccess,1,MPI_Type<int32_t>(),MPI_SUM,0,comm);
-      MPI_Bcast(&globalSuccess,1,MPI_Type<int32_t>(),0,comm);
+      // Sum mySuccess values to all processes:
+      MPI_Allreduce(&mySuccess,&globalSuccess,1,MPI_Type<int32_t>(),MPI_SUM,comm);
 
       // If globalSuccess equals zero all processes called this function with myStatus set to 'true':
       if (globalSuccess == 0) return true;
@@ -143,4 +143,78 @@ namespace vlsv {
       }
    }
 
+   /** MPI reduction operator that combines CRC32C checksums of consecutive pieces of data.
+    * Each element is a pair [checksum,bytes], and the element in invec belongs to data 
+    * that precedes the data of the element in inoutvec.*/
+   static void combineChecksums(void* invec,void* inoutvec,int* len,MPI_Datatype* datatype) {
+      const uint64_t* in = reinterpret_cast<const uint64_t*>(invec);
+      uint64_t* inout = reinterpret_cast<uint64_t*>(inoutvec);
+      for (int i=0; i<*len; ++i) {
+         inout[2*i+0] = crc32cCombine(in[2*i+0],inout[2*i+0],inout[2*i+1]);
+         inout[2*i+1] = in[2*i+1] + inout[2*i+1];
+      }
+   }
+
+   /** Combine CRC32C checksums of data pieces stored by each process in rank order, 
+    * i.e., calculate checksums of the data of all processes concatenated in rank order. 
+    * This function must be called by all processes in communicator comm.
+    * @param myChecksums Checksums of this process, given as [checksum,bytes] pairs.
+    * @param N_checksums Number of pairs in myChecksums.
+    * @param checksums Array in which the combined [checksum,bytes] pairs are written, 
+    * significant at root process only.
+    * @param root Rank of the process that receives the combined checksums.
+    * @param comm MPI communicator.
+    * @return If true, checksums were combined successfully.*/
+   bool reduceChecksums(const uint64_t* myChecksums,const int& N_checksums,uint64_t* checksums,const int& root,MPI_Comm comm) {
+      // Pairs are reduced as single elements so that MPI never splits them:
+      MPI_Datatype pairType;
+      MPI_Type_contiguous(2,MPI_Type<uint64_t>(),&pairType);
+      MPI_Type_commit(&pairType);
+      MPI_Op combineOp;
+      MPI_Op_create(combineChecksums,0,&combineOp);
+
+      bool success = true;
+      if (MPI_Reduce(const_cast<uint64_t*>(myChecksums),checksums,N_checksums,pairType,combineOp,root,comm) != MPI_SUCCESS) success = false;
+
+      MPI_Op_free(&combineOp);
+      MPI_Type_free(&pairType);
+      return success;
+   }
+
+   /** MPI reduction operator that combines statistics of vector components. 
+    * Each element is a tuple [min,max,sum,count].*/
+   static void combineStatistics(void* invec,void* inoutvec,int* len,MPI_Datatype* datatype) {
+      const double* in = reinterpret_cast<const double*>(invec);
+      double* inout = reinterpret_cast<double*>(inoutvec);
+      for (int i=0; i<*len; ++i) {
+         if (in[4*i+0] < inout[4*i+0]) inout[4*i+0] = in[4*i+0];
+         if (in[4*i+1] > inout[4*i+1]) inout[4*i+1] = in[4*i+1];
+         inout[4*i+2] += in[4*i+2];
+         inout[4*i+3] += in[4*i+3];
+      }
+   }
+
+   /** Combine per-component statistics of array data of all processes. 
+    * This function must be called by all processes in communicator comm.
+    * @param myStatistics Statistics of this process, given as [min,max,sum,count] tuples.
+    * @param N_components Number of tuples in myStatistics.
+    * @param statistics Array in which the combined tuples are written, significant at root process only.
+    * @param root Rank of the process that receives the combined statistics.
+    * @param comm MPI communicator.
+    * @return If true, statistics were combined successfully.*/
+   bool reduceStatistics(const double* myStatistics,const int& N_components,double* statistics,const int& root,MPI_Comm comm) {
+      MPI_Datatype tupleType;
+      MPI_Type_contiguous(4,MPI_Type<double>(),&tupleType);
+      MPI_Type_commit(&tupleType);
+      MPI_Op combineOp;
+      MPI_Op_create(combineStatistics,1,&combineOp);
+
+      bool success = true;
+      if (MPI_Reduce(const_cast<double*>(myStatistics),statistics,N_components,tupleType,combineOp,root,comm) != MPI_SUCCESS) success = false;
+
+      MPI_Op_free(&combineOp);
+      MPI_Type_free(&tupleType);
+      return success;
+   }
+
 } // namespace vlsv
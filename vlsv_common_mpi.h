@@ -28,6 +28,8 @@ namespace vlsv {
 
    bool checkSuccess(const bool& myStatus,MPI_Comm comm);
    MPI_Datatype getMPIDatatype(datatype::type dt,uint64_t dataSize);
+   bool reduceChecksums(const uint64_t* myChecksums,const int& N_checksums,uint64_t* checksums,const int& root,MPI_Comm comm);
+   bool reduceStatistics(const double* myStatistics,const int& N_components,double* statistics,const int& root,MPI_Comm comm);
 }
 
 #endif
@@ -0,0 +1,256 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef VLSV_HAVE_ZLIB
+   #include <zlib.h>
+#endif
+
+#include "vlsv_compression.h"
+
+using namespace std;
+
+namespace vlsv {
+
+   /** Compress a chunk of array data. Data is byte-shuffled before compression, which
+    * groups bytes of equal significance together and greatly improves the compression
+    * ratio of floating point data. If compression does not reduce the size of the
+    * chunk, the data is copied to output as is.
+    * @param method Compression method.
+    * @param input Uncompressed data.
+    * @param bytes Number of bytes in input.
+    * @param dataSize Byte size of the primitive datatype stored in input.
+    * @param output Buffer in which the compressed data is written, must be
+    * at least getCompressBound(method,bytes) bytes in size.
+    * @param outputBytes Variable in which the number of bytes written to output is written.
+    * @param workspace Temporary buffer used in byte shuffle.
+    * @return If true, the chunk was compressed successfully.*/
+   bool compressChunk(compression::type method,const char* input,const uint64_t& bytes,const uint64_t& dataSize,
+                      char* output,uint64_t& outputBytes,std::vector<char>& workspace) {
+      outputBytes = 0;
+      if (compressionSupported(method) == false) return false;
+      if (bytes == 0) return true;
+
+      #ifdef VLSV_HAVE_ZLIB
+      if (method == compression::ZLIB) {
+         const char* source = input;
+         if (dataSize > 1) {
+            workspace.resize(bytes);
+            shuffleBytes(input,bytes,dataSize,&(workspace[0]));
+            source = &(workspace[0]);
+         }
+
+         uLongf compressedBytes = compressBound(bytes);
+         if (compress2(reinterpret_cast<Bytef*>(output),&compressedBytes,
+                       reinterpret_cast<const Bytef*>(source),bytes,Z_BEST_SPEED) != Z_OK) return false;
+         if (compressedBytes < bytes) {
+            outputBytes = compressedBytes;
+            return true;
+         }
+      }
+      #endif
+
+      // Incompressible data is stored as is:
+      memcpy(output,input,bytes);
+      outputBytes = bytes;
+      return true;
+   }
+
+   /** Query if this build of VLSV supports the given compression method.
+    * @param method Compression method.
+    * @return If true, arrays can be compressed and decompressed using the method.*/
+   bool compressionSupported(compression::type method) {
+      switch (method) {
+       case compression::NONE:
+         return true;
+         break;
+       case compression::ZLIB:
+         #ifdef VLSV_HAVE_ZLIB
+            return true;
+         #else
+            return false;
+         #endif
+         break;
+       default:
+         return false;
+         break;
+      }
+   }
+
+   /** Decompress a chunk of array data that was compressed with compressChunk.
+    * @param method Compression method.
+    * @param input Compressed data.
+    * @param inputBytes Number of bytes in input.
+    * @param dataSize Byte size of the primitive datatype stored in the chunk.
+    * @param output Buffer in which the uncompressed data is written.
+    * @param outputBytes Number of bytes in uncompressed data.
+    * @param workspace Temporary buffer used in byte shuffle.
+    * @return If true, the chunk was decompressed successfully.*/
+   bool decompressChunk(compression::type method,const char* input,const uint64_t& inputBytes,const uint64_t& dataSize,
+                        char* output,const uint64_t& outputBytes,std::vector<char>& workspace) {
+      if (compressionSupported(method) == false) return false;
+      if (outputBytes == 0) return true;
+
+      // Chunks that did not compress were stored as is:
+      if (inputBytes == outputBytes) {
+         memcpy(output,input,outputBytes);
+         return true;
+      }
+
+      #ifdef VLSV_HAVE_ZLIB
+      if (method == compression::ZLIB) {
+         char* destination = output;
+         if (dataSize > 1) {
+            workspace.resize(outputBytes);
+            destination = &(workspace[0]);
+         }
+
+         uLongf uncompressedBytes = outputBytes;
+         if (uncompress(reinterpret_cast<Bytef*>(destination),&uncompressedBytes,
+                        reinterpret_cast<const Bytef*>(input),inputBytes) != Z_OK) return false;
+         if (uncompressedBytes != outputBytes) return false;
+
+         if (dataSize > 1) unshuffleBytes(destination,outputBytes,dataSize,output);
+         return true;
+      }
+      #endif
+      return false;
+   }
+
+   /** Get the maximum number of bytes compressChunk may write when compressing the given amount of data.
+    * @param method Compression method.
+    * @param bytes Number of uncompressed bytes.
+    * @return Upper bound for the compressed size.*/
+   uint64_t getCompressBound(compression::type method,const uint64_t& bytes) {
+      uint64_t bound = bytes;
+      #ifdef VLSV_HAVE_ZLIB
+      if (method == compression::ZLIB) bound = compressBound(bytes);
+      #endif
+      if (bound < bytes) bound = bytes;
+      return bound;
+   }
+
+   /** Convert double precision values to single precision, and round the mantissas 
+    * of the converted values to the given number of bits. Values are rounded only once: 
+    * the double precision mantissas are rounded to at most 23 bits, after which the 
+    * conversion to single precision is exact for values in the normal range of float.
+    * @param input Input values.
+    * @param N_values Number of values in input.
+    * @param mantissaBits Number of mantissa bits kept in output values, a negative 
+    * value keeps full single precision.
+    * @param output Output values.*/
+   void narrowToFloat(const double* input,const uint64_t& N_values,const int& mantissaBits,float* output) {
+      if (mantissaBits < 0) {
+         for (uint64_t i=0; i<N_values; ++i) output[i] = static_cast<float>(input[i]);
+         return;
+      }
+
+      // Values are rounded in blocks that fit in a small buffer:
+      const int bits = min(mantissaBits,23);
+      const uint64_t blockValues = 1024;
+      double rounded[blockValues];
+      for (uint64_t i=0; i<N_values; i+=blockValues) {
+         const uint64_t N = min(blockValues,N_values-i);
+         roundMantissa(input+i,N,bits,rounded);
+         for (uint64_t j=0; j<N; ++j) output[i+j] = static_cast<float>(rounded[j]);
+      }
+   }
+
+   /** Round the mantissas of double precision values to nearest, ties to even. Infinities 
+    * and NaNs are not modified. The loop is free of branches so that the compiler can 
+    * vectorize it.
+    * @param input Input values.
+    * @param N_values Number of values in input.
+    * @param mantissaBits Number of mantissa bits kept, values larger than 51 leave the input unchanged.
+    * @param output Output values, may be the same array as input.*/
+   void roundMantissa(const double* input,const uint64_t& N_values,const int& mantissaBits,double* output) {
+      if (mantissaBits < 0 || mantissaBits >= 52) {
+         if (output != input) memcpy(output,input,N_values*sizeof(double));
+         return;
+      }
+      const int droppedBits = 52 - mantissaBits;
+      const uint64_t exponentMask = 0x7FF0000000000000ULL;
+      const uint64_t half = (1ULL << (droppedBits-1)) - 1;
+      const uint64_t mask = ~((1ULL << droppedBits) - 1);
+
+      for (uint64_t i=0; i<N_values; ++i) {
+         uint64_t bits;
+         memcpy(&bits,input+i,sizeof(uint64_t));
+         uint64_t rounded = (bits + half + ((bits >> droppedBits) & 1)) & mask;
+         rounded = ((bits & exponentMask) == exponentMask) ? bits : rounded;
+         memcpy(output+i,&rounded,sizeof(uint64_t));
+      }
+   }
+
+   /** Round the mantissas of single precision values to nearest, ties to even. Infinities 
+    * and NaNs are not modified. The loop is free of branches so that the compiler can 
+    * vectorize it.
+    * @param input Input values.
+    * @param N_values Number of values in input.
+    * @param mantissaBits Number of mantissa bits kept, values larger than 22 leave the input unchanged.
+    * @param output Output values, may be the same array as input.*/
+   void roundMantissa(const float* input,const uint64_t& N_values,const int& mantissaBits,float* output) {
+      if (mantissaBits < 0 || mantissaBits >= 23) {
+         if (output != input) memcpy(output,input,N_values*sizeof(float));
+         return;
+      }
+      const int droppedBits = 23 - mantissaBits;
+      const uint32_t exponentMask = 0x7F800000U;
+      const uint32_t half = (1U << (droppedBits-1)) - 1;
+      const uint32_t mask = ~((1U << droppedBits) - 1);
+
+      for (uint64_t i=0; i<N_values; ++i) {
+         uint32_t bits;
+         memcpy(&bits,input+i,sizeof(uint32_t));
+         uint32_t rounded = (bits + half + ((bits >> droppedBits) & 1)) & mask;
+         rounded = ((bits & exponentMask) == exponentMask) ? bits : rounded;
+         memcpy(output+i,&rounded,sizeof(uint32_t));
+      }
+   }
+
+   /** Shuffle bytes of an array of primitive values so that the first bytes of all values
+    * are stored first, followed by the second bytes of all values, and so on.
+    * @param input Input array.
+    * @param bytes Number of bytes in input array.
+    * @param dataSize Byte size of each value in input array.
+    * @param output Output array, must not overlap with input.*/
+   void shuffleBytes(const char* input,const uint64_t& bytes,const uint64_t& dataSize,char* output) {
+      const uint64_t N_values = bytes / dataSize;
+      for (uint64_t b=0; b<dataSize; ++b) {
+         char* out = output + b*N_values;
+         for (uint64_t i=0; i<N_values; ++i) out[i] = input[i*dataSize+b];
+      }
+   }
+
+   /** Reverse the byte shuffle made by shuffleBytes.
+    * @param input Shuffled array.
+    * @param bytes Number of bytes in shuffled array.
+    * @param dataSize Byte size of each value in the original array.
+    * @param output Output array, must not overlap with input.*/
+   void unshuffleBytes(const char* input,const uint64_t& bytes,const uint64_t& dataSize,char* output) {
+      const uint64_t N_values = bytes / dataSize;
+      for (uint64_t b=0; b<dataSize; ++b) {
+         const char* in = input + b*N_values;
+         for (uint64_t i=0; i<N_values; ++i) output[i*dataSize+b] = in[i];
+      }
+   }
+
+} // namespace vlsv
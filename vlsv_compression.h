@@ -0,0 +1,67 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VLSV_COMPRESSION_H
+#define VLSV_COMPRESSION_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "vlsv_common.h"
+
+/** Compressed arrays are stored in a VLSV file as follows. Each process splits its part
+ * of the array into chunks of whole array elements, and each chunk is compressed
+ * independently. The compressed chunks of all processes are stored in rank order
+ * starting from the array offset given in the footer. They are followed by a chunk
+ * table that has two 64-bit unsigned integers per chunk: the number of array elements
+ * in the chunk, and the number of bytes the chunk occupies in the file. A chunk whose
+ * stored size equals its uncompressed size is stored as is. Compressed arrays have
+ * the following additional attributes in the footer:
+ *
+ * compression (string)          Compression method, see vlsv::compression.
+ * chunks (uint)                 Number of chunks in the array.
+ * chunkindex (uint)             File offset of the chunk table.
+ *
+ * Zlib compression is only available if VLSV was compiled with VLSV_HAVE_ZLIB defined.
+ *
+ * Floating point arrays can also be stored with reduced precision, see Writer::setPrecision. 
+ * Mantissas are rounded to nearest (ties to even) to the given number of bits, which makes 
+ * the data much more compressible. Relative error of each value is at most 2^-(mantissabits+1). 
+ * Such arrays have the following additional attributes in the footer:
+ *
+ * mantissabits (uint)           Number of mantissa bits kept in each value.
+ * originaldatasize (uint)       Byte size of the values before they were narrowed to floats.
+ */
+
+namespace vlsv {
+
+   bool compressChunk(compression::type method,const char* input,const uint64_t& bytes,const uint64_t& dataSize,
+                      char* output,uint64_t& outputBytes,std::vector<char>& workspace);
+   bool compressionSupported(compression::type method);
+   bool decompressChunk(compression::type method,const char* input,const uint64_t& inputBytes,const uint64_t& dataSize,
+                        char* output,const uint64_t& outputBytes,std::vector<char>& workspace);
+   uint64_t getCompressBound(compression::type method,const uint64_t& bytes);
+   void narrowToFloat(const double* input,const uint64_t& N_values,const int& mantissaBits,float* output);
+   void roundMantissa(const double* input,const uint64_t& N_values,const int& mantissaBits,double* output);
+   void roundMantissa(const float* input,const uint64_t& N_values,const int& mantissaBits,float* output);
+   void shuffleBytes(const char* input,const uint64_t& bytes,const uint64_t& dataSize,char* output);
+   void unshuffleBytes(const char* input,const uint64_t& bytes,const uint64_t& dataSize,char* output);
+
+} // namespace vlsv
+
+#endif
@@ -0,0 +1,324 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "mpiconversion.h"
+#include "vlsv_common_mpi.h"
+#include "vlsv_hints.h"
+#include "vlsv_writer.h"
+
+using namespace std;
+
+namespace vlsv {
+
+   /** Get a string describing the geometry of the job, i.e., the number of
+    * processes and shared memory nodes in the given communicator. Hints in
+    * the hint cache are keyed by this string. This function must be called
+    * by all processes in the communicator.
+    * @param comm MPI communicator.
+    * @return Job geometry as "<processes>x<nodes>".*/
+   std::string getJobGeometry(MPI_Comm comm) {
+      int myRank,N_processes;
+      MPI_Comm_rank(comm,&myRank);
+      MPI_Comm_size(comm,&N_processes);
+
+      // Count nodes by counting processes that have rank zero on their node:
+      MPI_Comm nodeComm;
+      int nodeRank;
+      MPI_Comm_split_type(comm,MPI_COMM_TYPE_SHARED,myRank,MPI_INFO_NULL,&nodeComm);
+      MPI_Comm_rank(nodeComm,&nodeRank);
+      MPI_Comm_free(&nodeComm);
+      int myNodes = (nodeRank == 0) ? 1 : 0;
+      int N_nodes;
+      MPI_Allreduce(&myNodes,&N_nodes,1,MPI_Type<int>(),MPI_SUM,comm);
+
+      stringstream ss;
+      ss << N_processes << 'x' << N_nodes;
+      return ss.str();
+   }
+
+   /** Get the sizes of the arrays in a recorded file layout. Array sizes are
+    * the distances between consecutive array offsets, the size of the last
+    * array includes the footer. The sizes can be passed to tuneHints to
+    * benchmark a workload shaped like the file that was written last.
+    * @param layout Layout recorded by Writer, see Writer::setLayout.
+    * @param arrayBytes Vector in which the total byte size of each array is written.*/
+   void getLayoutShape(const WriteLayout& layout,std::vector<uint64_t>& arrayBytes) {
+      arrayBytes.clear();
+      const vector<uint64_t>& offsets = layout.getArrayOffsets();
+      for (size_t a=0; a<offsets.size(); ++a) {
+         const uint64_t end = (a+1 < offsets.size()) ? offsets[a+1] : layout.getFileSize();
+         if (end > offsets[a]) arrayBytes.push_back(end-offsets[a]);
+      }
+   }
+
+   /** Convert the hints in the given MPI info object into a string of
+    * space-separated key=value pairs.
+    * @param hints MPI info object, may be MPI_INFO_NULL.
+    * @return Hints as a string.*/
+   static string getHintString(MPI_Info hints) {
+      if (hints == MPI_INFO_NULL) return string();
+      int N_keys = 0;
+      MPI_Info_get_nkeys(hints,&N_keys);
+      stringstream ss;
+      for (int k=0; k<N_keys; ++k) {
+         char key[MPI_MAX_INFO_KEY+1];
+         char value[MPI_MAX_INFO_VAL+1];
+         int flag = 0;
+         MPI_Info_get_nthkey(hints,k,key);
+         MPI_Info_get(hints,key,MPI_MAX_INFO_VAL,value,&flag);
+         if (flag == 0) continue;
+         if (k > 0) ss << ' ';
+         ss << key << '=' << value;
+      }
+      return ss.str();
+   }
+
+   /** Load the tuned hints of the current job geometry from a hint cache, and
+    * merge them with the hints given by the user. Hints given by the user are
+    * not overridden. Master process (rank zero) reads the cache file. This
+    * function must be called by all processes in the communicator.
+    * @param cacheFile Name of the hint cache file.
+    * @param comm MPI communicator.
+    * @param userInfo MPI info given by the user, may be MPI_INFO_NULL.
+    * @param info Variable in which the merged info object is written, must be freed by
+    * the caller. It contains the user's hints even if no cached hints were found.
+    * @return If true, cached hints were found for the current job geometry.*/
+   bool loadTunedHints(const std::string& cacheFile,MPI_Comm comm,MPI_Info userInfo,MPI_Info& info) {
+      const int masterRank = 0;
+      int myRank;
+      MPI_Comm_rank(comm,&myRank);
+      const string geometry = getJobGeometry(comm);
+
+      // Master finds the line of the current geometry and broadcasts its hints:
+      string hintString;
+      uint64_t found = 0;
+      if (myRank == masterRank) {
+         ifstream in(cacheFile.c_str());
+         string line;
+         while (getline(in,line)) {
+            if (line.empty() == true || line[0] == '#') continue;
+            stringstream ss(line);
+            string lineGeometry;
+            ss >> lineGeometry;
+            if (lineGeometry != geometry) continue;
+            getline(ss,hintString);
+            found = 1;
+         }
+      }
+      uint64_t sizes[2];
+      sizes[0] = found;
+      sizes[1] = hintString.size();
+      MPI_Bcast(sizes,2,MPI_Type<uint64_t>(),masterRank,comm);
+      hintString.resize(sizes[1]);
+      if (sizes[1] > 0) MPI_Bcast(&(hintString[0]),sizes[1],MPI_Type<char>(),masterRank,comm);
+
+      if (userInfo == MPI_INFO_NULL) MPI_Info_create(&info);
+      else MPI_Info_dup(userInfo,&info);
+
+      stringstream ss(hintString);
+      string hint;
+      while (ss >> hint) {
+         const size_t separator = hint.find('=');
+         if (separator == string::npos) continue;
+         const string key = hint.substr(0,separator);
+         const string value = hint.substr(separator+1);
+
+         char userValue[MPI_MAX_INFO_VAL];
+         int flag = 0;
+         MPI_Info_get(info,const_cast<char*>(key.c_str()),MPI_MAX_INFO_VAL-1,userValue,&flag);
+         if (flag != 0) continue;
+         MPI_Info_set(info,const_cast<char*>(key.c_str()),const_cast<char*>(value.c_str()));
+      }
+      return sizes[0] != 0;
+   }
+
+   /** Store hints of the current job geometry in a hint cache. Hints previously
+    * stored for the same geometry are replaced, other lines are kept. Master
+    * process (rank zero) writes the cache file. This function must be called
+    * by all processes in the communicator.
+    * @param cacheFile Name of the hint cache file, created if it does not exist.
+    * @param comm MPI communicator.
+    * @param hints Hints to store.
+    * @return If true, the hints were stored successfully. Return value is the same on all processes.*/
+   bool saveTunedHints(const std::string& cacheFile,MPI_Comm comm,MPI_Info hints) {
+      const int masterRank = 0;
+      int myRank;
+      MPI_Comm_rank(comm,&myRank);
+      const string geometry = getJobGeometry(comm);
+
+      bool success = true;
+      if (myRank == masterRank) {
+         vector<string> lines;
+         ifstream in(cacheFile.c_str());
+         string line;
+         while (getline(in,line)) {
+            stringstream ss(line);
+            string lineGeometry;
+            ss >> lineGeometry;
+            if (lineGeometry != geometry) lines.push_back(line);
+         }
+         in.close();
+         lines.push_back(geometry + ' ' + getHintString(hints));
+
+         ofstream out(cacheFile.c_str());
+         for (size_t l=0; l<lines.size(); ++l) out << lines[l] << endl;
+         out.close();
+         if (out.fail() == true) success = false;
+      }
+      return checkSuccess(success,comm);
+   }
+
+   /** Write a file shaped like the given workload using the given hints.
+    * @param testFile Name of the file written.
+    * @param comm MPI communicator.
+    * @param arrayBytes Total byte size of each array, divided evenly between processes.
+    * @param buffer Data written by this process, large enough for its share of the largest array.
+    * @param hints Hints passed to Writer::open.
+    * @param t Variable in which the maximum time used by a process is written.
+    * @return If true, the file was written successfully.*/
+   static bool writeWorkload(const string& testFile,MPI_Comm comm,const vector<uint64_t>& arrayBytes,
+                             const vector<char>& buffer,MPI_Info hints,double& t) {
+      int myRank,N_processes;
+      MPI_Comm_rank(comm,&myRank);
+      MPI_Comm_size(comm,&N_processes);
+
+      bool success = true;
+      MPI_Barrier(comm);
+      const double t_start = MPI_Wtime();
+      Writer vlsvWriter;
+      if (vlsvWriter.open(testFile,comm,0,hints) == false) success = false;
+      for (size_t a=0; a<arrayBytes.size() && success == true; ++a) {
+         uint64_t myBytes = arrayBytes[a] / N_processes;
+         if (static_cast<uint64_t>(myRank) < arrayBytes[a] % N_processes) ++myBytes;
+
+         stringstream ss;
+         ss << "tune_" << a;
+         map<string,string> attribs;
+         attribs["name"] = ss.str();
+         if (vlsvWriter.writeArray("VARIABLE",attribs,"uint",myBytes,1,1,&(buffer[0])) == false) success = false;
+      }
+      if (vlsvWriter.close() == false) success = false;
+      double myTime = MPI_Wtime() - t_start;
+      MPI_Allreduce(&myTime,&t,1,MPI_Type<double>(),MPI_MAX,comm);
+      return checkSuccess(success,comm);
+   }
+
+   /** Find the best combination of MPI-IO hints for writing the given workload.
+    * Collective buffering (romio_cb_write), the number of aggregators (cb_nodes),
+    * the size of the collective buffer (cb_buffer_size), and Lustre striping
+    * (striping_factor, striping_unit) are varied. A file shaped like the workload
+    * is written with each combination, and the combination with the smallest
+    * write time is returned. Hints that are not supported by the MPI library
+    * or the file system are ignored, in which case all combinations perform
+    * about equally. This function must be called by all processes in the communicator.
+    * @param testFile Name of the file written in the benchmark, it is deleted afterwards.
+    * It should be on the file system where the real output files are written.
+    * @param comm MPI communicator.
+    * @param arrayBytes Total byte size of each array in the workload, see getLayoutShape.
+    * @param best Variable in which the best hints are written, must be freed by the caller.
+    * @param bestTime Variable in which the write time with the best hints is written.
+    * @return If true, the benchmark completed successfully.*/
+   bool tuneHints(const std::string& testFile,MPI_Comm comm,const std::vector<uint64_t>& arrayBytes,
+                  MPI_Info& best,double& bestTime) {
+      best = MPI_INFO_NULL;
+      bestTime = 0;
+      if (arrayBytes.size() == 0) return false;
+
+      int myRank,N_processes;
+      MPI_Comm_rank(comm,&myRank);
+      MPI_Comm_size(comm,&N_processes);
+      stringstream geometry(getJobGeometry(comm));
+      int N_nodes = 1;
+      char separator;
+      geometry >> N_processes >> separator >> N_nodes;
+
+      // Candidate hint combinations. Buffer size and aggregator count
+      // only matter if collective buffering is enabled:
+      vector<int> aggregators;
+      aggregators.push_back(N_nodes);
+      if (2*N_nodes <= N_processes) aggregators.push_back(2*N_nodes);
+      const uint64_t MiB = 1024*1024;
+      const uint64_t bufferSizes[2] = {4*MiB,16*MiB};
+      const uint64_t stripeUnits[2] = {MiB,4*MiB};
+
+      vector<map<string,string> > candidates;
+      for (int cb=0; cb<2; ++cb) {
+         for (size_t n=0; n<aggregators.size(); ++n) {
+            for (int b=0; b<2; ++b) {
+               if (cb == 1 && b > 0) continue;
+               for (int s=0; s<2; ++s) {
+                  map<string,string> hints;
+                  stringstream ss;
+                  hints["romio_cb_write"] = (cb == 0) ? "enable" : "disable";
+                  ss << aggregators[n];
+                  hints["striping_factor"] = ss.str();
+                  if (cb == 0) {
+                     hints["cb_nodes"] = ss.str();
+                     ss.str("");
+                     ss << bufferSizes[b];
+                     hints["cb_buffer_size"] = ss.str();
+                  }
+                  ss.str("");
+                  ss << stripeUnits[s];
+                  hints["striping_unit"] = ss.str();
+                  candidates.push_back(hints);
+               }
+            }
+         }
+      }
+
+      // Each process writes its share of every array from the same buffer:
+      uint64_t maxBytes = 0;
+      for (size_t a=0; a<arrayBytes.size(); ++a) maxBytes = max(maxBytes,arrayBytes[a]/N_processes + 1);
+      vector<char> buffer(maxBytes);
+      for (size_t i=0; i<buffer.size(); ++i) buffer[i] = static_cast<char>(myRank+i);
+
+      // The first write is not timed, it warms up the file system and the MPI library:
+      double t;
+      bool success = writeWorkload(testFile,comm,arrayBytes,buffer,MPI_INFO_NULL,t);
+
+      size_t bestCandidate = 0;
+      for (size_t c=0; c<candidates.size() && success == true; ++c) {
+         MPI_Info hints;
+         MPI_Info_create(&hints);
+         for (map<string,string>::const_iterator it=candidates[c].begin(); it!=candidates[c].end(); ++it) {
+            MPI_Info_set(hints,const_cast<char*>(it->first.c_str()),const_cast<char*>(it->second.c_str()));
+         }
+         if (writeWorkload(testFile,comm,arrayBytes,buffer,hints,t) == false) success = false;
+         MPI_Info_free(&hints);
+         if (c == 0 || t < bestTime) {
+            bestCandidate = c;
+            bestTime = t;
+         }
+      }
+      if (myRank == 0) MPI_File_delete(const_cast<char*>(testFile.c_str()),MPI_INFO_NULL);
+      if (success == false) return false;
+
+      MPI_Info_create(&best);
+      for (map<string,string>::const_iterator it=candidates[bestCandidate].begin(); it!=candidates[bestCandidate].end(); ++it) {
+         MPI_Info_set(best,const_cast<char*>(it->first.c_str()),const_cast<char*>(it->second.c_str()));
+      }
+      return true;
+   }
+
+} // namespace vlsv
@@ -0,0 +1,52 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VLSV_HINTS_H
+#define VLSV_HINTS_H
+
+#include <mpi.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** MPI-IO hints found by tuneHints are stored in a hint cache, which is a text file
+ * with one line per job geometry:
+ *
+ * <processes>x<nodes> <key>=<value> <key>=<value> ...
+ *
+ * for example "64x4 cb_nodes=4 cb_buffer_size=16777216 romio_cb_write=enable". Lines
+ * starting with '#' are comments. Writer and ParallelReader apply the cached hints of
+ * the current job geometry when a file is opened, see Writer::setHintCache. Cached
+ * hints never override the hints given by the user. The cache can be created with
+ * the vlsvtune utility.
+ */
+
+namespace vlsv {
+
+   class WriteLayout;
+
+   std::string getJobGeometry(MPI_Comm comm);
+   void getLayoutShape(const WriteLayout& layout,std::vector<uint64_t>& arrayBytes);
+   bool loadTunedHints(const std::string& cacheFile,MPI_Comm comm,MPI_Info userInfo,MPI_Info& info);
+   bool saveTunedHints(const std::string& cacheFile,MPI_Comm comm,MPI_Info hints);
+   bool tuneHints(const std::string& testFile,MPI_Comm comm,const std::vector<uint64_t>& arrayBytes,
+                  MPI_Info& best,double& bestTime);
+
+} // namespace vlsv
+
+#endif
@@ -16,30 +16,75 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <string.h>
 
+#ifndef WINDOWS
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
 #include "portable_file_io.h"
+#include "vlsv_checksum.h"
+#include "vlsv_compression.h"
 #include "vlsv_reader.h"
 
 using namespace std;
 
 namespace vlsv {
 
+   /** Get the key of an array in the footer index. Name and mesh attributes 
+    * are optional, absent attributes are distinguished from empty values.
+    * @param tagName Name of the XML tag.
+    * @param name Value of the name attribute, NULL if not given.
+    * @param mesh Value of the mesh attribute, NULL if not given.
+    * @return Key in Reader::arrayIndex.*/
+   static string getIndexKey(const string& tagName,const string* name,const string* mesh) {
+      string key = tagName;
+      key += '\0';
+      if (name != NULL) key += 'n' + *name;
+      key += '\0';
+      if (mesh != NULL) key += 'm' + *mesh;
+      return key;
+   }
+
+   /** Get the value of an unsigned integer attribute of an XML tag.
+    * @param node XML tag.
+    * @param attribName Name of the attribute.
+    * @return Value of the attribute, zero if the tag has no such attribute.*/
+   static uint64_t getUIntAttribute(const muxml::XMLNode* node,const char* attribName) {
+      map<string,string>::const_iterator it = node->attributes.find(attribName);
+      if (it == node->attributes.end()) return 0;
+      return atol(it->second.c_str());
+   }
+
    Reader::Reader() {
       endiannessReader = detectEndianness();
       fileOpen = false;
+      footerOffset = 0;
+      mapping = NULL;
+      mappingBytes = 0;
+      memoryMapping = false;
       swapIntEndianness = false;
+      verifyChecksums = false;
    }
 
    Reader::~Reader() {
+      unmapFile();
       filein.close();   
    }
    
    bool Reader::close() {
+      unmapFile();
       filein.close();
       xmlReader.clear();
+      arrayIndex.clear();
+      footerOffset = 0;
+      verifiedArrays.clear();
       fileOpen = false;
       return true;
    }
@@ -51,9 +96,9 @@ namespace vlsv {
     * @return If true, an XML tag was found that mathes given constraints.*/
    bool Reader::getArrayAttributes(const string& tagName,const list<pair<string,string> >& attribsIn,map<string,string>& attribsOut) const {
       if (fileOpen == false) return false;
-      muxml::XMLNode* node = xmlReader.find(tagName,attribsIn);
-      if (node == NULL) return false;
-      attribsOut = node->attributes;   
+      ArrayEntry entry;
+      if (findArray(tagName,attribsIn,entry) == false) return false;
+      attribsOut = entry.node->attributes;   
       return true;
    }
 
@@ -69,23 +114,212 @@ namespace vlsv {
    bool Reader::getArrayInfo(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                              uint64_t& arraySize,uint64_t& vectorSize,datatype::type& dataType,uint64_t& dataSize) {
       if (fileOpen == false) return false;
-      muxml::XMLNode* node = xmlReader.find(tagName,attribs);
-      if (node == NULL) return false;
-   
-      arraySize = atol(node->attributes["arraysize"].c_str());
-      vectorSize = atol(node->attributes["vectorsize"].c_str());
-      dataSize = atol(node->attributes["datasize"].c_str());
-      if (node->attributes["datatype"] == "unknown") dataType = datatype::UNKNOWN;
-      else if (node->attributes["datatype"] == "int") dataType = datatype::INT;
-      else if (node->attributes["datatype"] == "uint") dataType = datatype::UINT;
-      else if (node->attributes["datatype"] == "float") dataType = datatype::FLOAT;
-      else {
-         cerr << "vlsv::Reader ERROR: Unknown datatype '" << node->attributes["datatype"] << "' in tag!" << endl;
+      ArrayEntry entry;
+      if (findArray(tagName,attribs,entry) == false) return false;
+      if (entry.validDataType == false) {
+         cerr << "vlsv::Reader ERROR: Unknown datatype '" << entry.node->attributes["datatype"] << "' in tag!" << endl;
          return false;
       }
+
+      arraySize = entry.arraySize;
+      vectorSize = entry.vectorSize;
+      dataSize = entry.dataSize;
+      dataType = entry.dataType;
+      return true;
+   }
+
+   /** Decompress the given chunks of the currently open array, and copy the 
+    * requested array elements to the output buffer.
+    * @param chunkTable Chunk table of the array, see vlsv_compression.h.
+    * @param firstChunk Index of the first chunk in input.
+    * @param endChunk Index of the chunk after the last chunk in input.
+    * @param firstElement Index of the first array element in chunk firstChunk.
+    * @param begin Index of the first requested array element.
+    * @param amount Number of requested array elements.
+    * @param input Compressed data of the chunks.
+    * @param buffer Buffer in which the requested array elements are written.
+    * @return If true, all chunks were decompressed successfully.*/
+   bool Reader::decompressChunks(const std::vector<uint64_t>& chunkTable,const size_t& firstChunk,const size_t& endChunk,
+                                 const uint64_t& firstElement,const uint64_t& begin,const uint64_t& amount,
+                                 const char* input,char* buffer) const {
+      const uint64_t elementBytes = arrayOpen.vectorSize*arrayOpen.dataSize;
+      vector<char> workspace;
+      vector<char> chunk;
+      uint64_t element = firstElement;
+      for (size_t c=firstChunk; c<endChunk; ++c) {
+         const uint64_t elements = chunkTable[2*c+0];
+         const uint64_t storedBytes = chunkTable[2*c+1];
+
+         // Chunks that are completely inside the requested range are 
+         // decompressed directly to output buffer:
+         const uint64_t first = max(element,begin);
+         const uint64_t last  = min(element+elements,begin+amount);
+         const bool partial = (first != element || last != element+elements);
+         char* output = buffer + (first-begin)*elementBytes;
+         if (partial == true) {
+            chunk.resize(elements*elementBytes);
+            output = &(chunk[0]);
+         }
+
+         if (decompressChunk(arrayOpen.compression,input,storedBytes,arrayOpen.dataSize,
+                             output,elements*elementBytes,workspace) == false) {
+            cerr << "vlsv::Reader ERROR: Failed to decompress chunk " << c << " of array!" << endl;
+            return false;
+         }
+         if (partial == true) {
+            memcpy(buffer+(first-begin)*elementBytes,output+(first-element)*elementBytes,(last-first)*elementBytes);
+         }
+
+         input += storedBytes;
+         element += elements;
+      }
+      return true;
+   }
+
+   /** Find an array in the footer. Queries constrained only by the name and mesh 
+    * attributes are answered from the footer index, other queries search the XML 
+    * tree. Both return the first matching tag in the order of MuXML::find.
+    * @param tagName Name of the XML tag.
+    * @param attribs Constraints that limit the search.
+    * @param entry Variable in which the metadata of the found array is written.
+    * @return If true, an array matching the constraints was found.*/
+   bool Reader::findArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                          ArrayEntry& entry) const {
+      const string* name = NULL;
+      const string* mesh = NULL;
+      bool indexed = true;
+      for (list<pair<string,string> >::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
+         if (it->first == "name" && name == NULL) name = &(it->second);
+         else if (it->first == "mesh" && mesh == NULL) mesh = &(it->second);
+         else indexed = false;
+      }
+
+      if (indexed == true) {
+         unordered_map<string,ArrayEntry>::const_iterator it = arrayIndex.find(getIndexKey(tagName,name,mesh));
+         if (it == arrayIndex.end()) return false;
+         entry = it->second;
+         return true;
+      }
+
+      muxml::XMLNode* node = xmlReader.find(tagName,attribs);
+      if (node == NULL) return false;
+      parseArrayEntry(node,entry);
       return true;
    }
 
+   /** Get the file offsets, stored sizes, and checksums of all arrays that have a checksum.
+    * Called by master process only.
+    * @param names Description of each array, tag name followed by name and mesh attributes.
+    * @param checksums Offset, number of stored bytes, and checksum of each array.*/
+   void Reader::getChecksummedArrays(std::vector<std::string>& names,std::vector<uint64_t>& checksums) {
+      names.clear();
+      checksums.clear();
+      muxml::XMLNode* vlsv = xmlReader.find("VLSV");
+      if (vlsv == NULL) return;
+
+      for (multimap<string,muxml::XMLNode*>::const_iterator it=vlsv->children.begin(); it!=vlsv->children.end(); ++it) {
+         muxml::XMLNode* node = it->second;
+         if (node->attributes.find("crc32c") == node->attributes.end()) continue;
+         ArrayEntry entry;
+         parseArrayEntry(node,entry);
+         if (loadArrayEntry(it->first,entry) == false) continue;
+
+         string name = it->first;
+         map<string,string>::const_iterator attrib = node->attributes.find("name");
+         if (attrib != node->attributes.end()) name += " name='" + attrib->second + "'";
+         attrib = node->attributes.find("mesh");
+         if (attrib != node->attributes.end()) name += " mesh='" + attrib->second + "'";
+         names.push_back(name);
+         checksums.push_back(arrayOpen.offset);
+         checksums.push_back(getStoredBytes());
+         checksums.push_back(arrayOpen.checksum);
+      }
+   }
+
+   /** Get a pointer to the given part of an array in the memory mapped input file. 
+    * This succeeds only if the array is stored uncompressed in the input file with 
+    * the requested datatype and byte order, and if the data is suitably aligned. 
+    * Kernel is advised to read ahead the requested part of the array.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that uniquely determine the array.
+    * @param begin Index of the first requested array element.
+    * @param amount Number of requested array elements.
+    * @param dataType Requested datatype, see getStringDatatype.
+    * @param dataSize Byte size of the requested datatype.
+    * @param vectorSize Variable in which the vector size of the array is written.
+    * @return Pointer to the data, or NULL if the data cannot be accessed in place.*/
+   const char* Reader::getMappedArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                      const uint64_t& begin,const uint64_t& amount,const std::string& dataType,
+                                      const uint64_t& dataSize,uint64_t& vectorSize) {
+      if (mapping == NULL) return NULL;
+      if (loadArray(tagName,attribs) == false) return NULL;
+      if (arrayOpen.compression != compression::NONE || arrayOpen.subfiles > 0 || arrayOpen.file.empty() == false) return NULL;
+      if (swapIntEndianness == true) return NULL;
+      if (getStringDatatype(arrayOpen.dataType) != dataType || arrayOpen.dataSize != dataSize) return NULL;
+      if (begin + amount > arrayOpen.arraySize) return NULL;
+
+      // Array must be inside the mapping, which does not cover data appended after 
+      // the file was opened, and values must be aligned to their size:
+      const uint64_t elementBytes = arrayOpen.vectorSize*arrayOpen.dataSize;
+      const uint64_t start = arrayOpen.offset + begin*elementBytes;
+      const uint64_t bytes = amount*elementBytes;
+      if (start + bytes > mappingBytes) return NULL;
+      if (start % dataSize != 0) return NULL;
+      if (verifyOpenArrayChecksum() == false) return NULL;
+
+      #ifndef WINDOWS
+         if (bytes > 0) {
+            const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+            const uint64_t pageStart = start - start % pageSize;
+            madvise(mapping+pageStart,start+bytes-pageStart,MADV_WILLNEED);
+         }
+      #endif
+      vectorSize = arrayOpen.vectorSize;
+      return mapping + start;
+   }
+
+   /** Get the number of bytes stored in the file for the currently open array.
+    * For compressed arrays this includes the chunk table, which follows the compressed data.
+    * @return Number of bytes.*/
+   uint64_t Reader::getStoredBytes() const {
+      if (arrayOpen.compression != compression::NONE) {
+         return arrayOpen.chunkIndexOffset + 2*arrayOpen.chunks*sizeof(uint64_t) - arrayOpen.offset;
+      }
+      return arrayOpen.arraySize*arrayOpen.vectorSize*arrayOpen.dataSize;
+   }
+
+   /** Find the compressed chunks of the currently open array that 
+    * contain the given array elements.
+    * @param chunkTable Chunk table of the array, see vlsv_compression.h.
+    * @param begin Index of the first requested array element.
+    * @param amount Number of requested array elements.
+    * @param firstChunk Variable in which the index of the first needed chunk is written.
+    * @param endChunk Variable in which the index of the chunk after the last needed chunk is written.
+    * @param firstElement Variable in which the index of the first array element in chunk firstChunk is written.
+    * @param byteOffset Variable in which the offset of chunk firstChunk relative to array start is written.
+    * @param bytes Variable in which the total stored size of the needed chunks is written.*/
+   void Reader::getChunkRange(const std::vector<uint64_t>& chunkTable,const uint64_t& begin,const uint64_t& amount,
+                              size_t& firstChunk,size_t& endChunk,uint64_t& firstElement,uint64_t& byteOffset,uint64_t& bytes) const {
+      const size_t N_chunks = chunkTable.size()/2;
+      firstChunk = 0;
+      firstElement = 0;
+      byteOffset = 0;
+      while (firstChunk < N_chunks && firstElement+chunkTable[2*firstChunk] <= begin) {
+         firstElement += chunkTable[2*firstChunk+0];
+         byteOffset   += chunkTable[2*firstChunk+1];
+         ++firstChunk;
+      }
+
+      endChunk = firstChunk;
+      bytes = 0;
+      uint64_t element = firstElement;
+      while (amount > 0 && endChunk < N_chunks && element < begin+amount) {
+         element += chunkTable[2*endChunk+0];
+         bytes   += chunkTable[2*endChunk+1];
+         ++endChunk;
+      }
+   }
+
    bool Reader::getFileName(std::string& openFile) const {
       if (fileOpen == false) {
          openFile = "";
@@ -105,6 +339,7 @@ namespace vlsv {
       if (fileOpen == false) return false;
 
       muxml::XMLNode* node = xmlReader.find("VLSV");
+      if (node == NULL) return true;
       for (multimap<string,muxml::XMLNode*>::const_iterator it=node->children.lower_bound(tagName); 
            it!=node->children.upper_bound(tagName); ++it) {
          map<string,string>::const_iterator tmp = it->second->attributes.find(attribName);
@@ -114,34 +349,167 @@ namespace vlsv {
       return true;
    }
 
+   /** Build the footer index. Each tag is indexed by its tag name combined with 
+    * every subset of its name and mesh attributes, so that any query constrained 
+    * by these attributes is a single lookup. Called whenever a footer is parsed, 
+    * see readFooter.*/
+   void Reader::indexFooter() {
+      arrayIndex.clear();
+      indexNodes(xmlReader.getRoot());
+   }
+
+   /** Add an XML tag to the footer index. Only the first tag with each key is 
+    * kept, thus tags must be added in the order of MuXML::find.
+    * @param tagName Name of the XML tag.
+    * @param entry Metadata of the XML tag.*/
+   void Reader::indexNode(const std::string& tagName,const ArrayEntry& entry) {
+      const muxml::XMLNode* node = entry.node;
+      map<string,string>::const_iterator name = node->attributes.find("name");
+      map<string,string>::const_iterator mesh = node->attributes.find("mesh");
+      const string* names[2] = {NULL,(name != node->attributes.end()) ? &(name->second) : NULL};
+      const string* meshes[2] = {NULL,(mesh != node->attributes.end()) ? &(mesh->second) : NULL};
+      for (int n=0; n<2; ++n) {
+         if (n == 1 && names[1] == NULL) continue;
+         for (int m=0; m<2; ++m) {
+            if (m == 1 && meshes[1] == NULL) continue;
+            arrayIndex.insert(make_pair(getIndexKey(tagName,names[n],meshes[m]),entry));
+         }
+      }
+   }
+
+   /** Add the descendants of the given XML tag to the footer index. Tags are 
+    * visited in the order of MuXML::find, so that index lookups return the 
+    * same tag as MuXML::find.
+    * @param parent XML tag whose descendants are indexed.*/
+   void Reader::indexNodes(const muxml::XMLNode* parent) {
+      for (multimap<string,muxml::XMLNode*>::const_iterator it=parent->children.begin(); it!=parent->children.end(); ++it) {
+         ArrayEntry entry;
+         parseArrayEntry(it->second,entry);
+         indexNode(it->first,entry);
+         indexNodes(it->second);
+      }
+   }
+
    bool Reader::loadArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) {
       if (fileOpen == false) return false;
    
       // Find tag corresponding to given array:
-      muxml::XMLNode* node = xmlReader.find(tagName,attribs);
-      if (node == NULL) return false;
+      ArrayEntry entry;
+      if (findArray(tagName,attribs,entry) == false) return false;
+      return loadArrayEntry(tagName,entry);
+   }
+
+   /** Load checksum information of an array to arrayOpen.
+    * @param node XML tag of the array.
+    * @return If true, checksum information was loaded successfully.*/
+   bool Reader::loadArrayChecksum(muxml::XMLNode* node) {
+      arrayOpen.hasChecksum = false;
+      arrayOpen.checksum = 0;
+
+      map<string,string>::const_iterator it = node->attributes.find("crc32c");
+      if (it == node->attributes.end()) return true;
+      arrayOpen.hasChecksum = true;
+      arrayOpen.checksum = strtoul(it->second.c_str(),NULL,10);
+      return true;
+   }
+
+   /** Copy compression information of an array from its XML tag to arrayOpen.
+    * @param node XML tag of the array.
+    * @return If false, the array has been compressed with an unsupported method.*/
+   bool Reader::loadArrayCompression(muxml::XMLNode* node) {
+      arrayOpen.compression = compression::NONE;
+      arrayOpen.chunks = 0;
+      arrayOpen.chunkIndexOffset = 0;
 
+      map<string,string>::const_iterator it = node->attributes.find("compression");
+      if (it == node->attributes.end()) return true;
+      arrayOpen.compression = getCompression(it->second);
+      if (compressionSupported(arrayOpen.compression) == false) {
+         cerr << "vlsv::Reader ERROR: Unsupported compression method '" << it->second << "' in tag!" << endl;
+         return false;
+      }
+      arrayOpen.chunks = atol(node->attributes["chunks"].c_str());
+      arrayOpen.chunkIndexOffset = atol(node->attributes["chunkindex"].c_str());
+      return true;
+   }
+
+   /** Load information of an array to arrayOpen.
+    * @param tagName Name of the XML tag of the array.
+    * @param entry Metadata of the array.
+    * @return If true, array information was loaded successfully.*/
+   bool Reader::loadArrayEntry(const std::string& tagName,const ArrayEntry& entry) {
       // Copy array information from tag:
-      arrayOpen.offset = atol(node->value.c_str());
+      muxml::XMLNode* node = entry.node;
+      arrayOpen.offset = entry.offset;
       arrayOpen.tagName = tagName;
-      arrayOpen.arraySize = atol(node->attributes["arraysize"].c_str());
-      arrayOpen.vectorSize = atol(node->attributes["vectorsize"].c_str());
-      arrayOpen.dataSize = atol(node->attributes["datasize"].c_str());
-      if (node->attributes["datatype"] == "unknown") arrayOpen.dataType = datatype::UNKNOWN;
-      else if (node->attributes["datatype"] == "int") arrayOpen.dataType = datatype::INT;
-      else if (node->attributes["datatype"] == "uint") arrayOpen.dataType = datatype::UINT;
-      else if (node->attributes["datatype"] == "float") arrayOpen.dataType = datatype::FLOAT;
-      else {
+      arrayOpen.arraySize = entry.arraySize;
+      arrayOpen.vectorSize = entry.vectorSize;
+      arrayOpen.dataSize = entry.dataSize;
+      arrayOpen.dataType = entry.dataType;
+      if (entry.validDataType == false) {
          cerr << "vlsv::Reader ERROR: Unknown datatype in tag!" << endl;
          return false;
       }   
       //if (arrayOpen.arraySize == 0) return false;
       if (arrayOpen.vectorSize == 0) return false;
       if (arrayOpen.dataSize == 0) return false;
+      if (loadArrayCompression(node) == false) return false;
+      if (loadArrayChecksum(node) == false) return false;
+      if (loadArraySubfiles(node) == false) return false;
+      if (loadArrayReference(node) == false) return false;
    
       return true;
    }
 
+   /** Load the name of the file containing the data of an array to arrayOpen, 
+    * if the array is a reference to an earlier file.
+    * @param node XML tag of the array.
+    * @return If true, reference information was loaded successfully.*/
+   bool Reader::loadArrayReference(muxml::XMLNode* node) {
+      arrayOpen.file.clear();
+      map<string,string>::const_iterator it = node->attributes.find("file");
+      if (it == node->attributes.end()) return true;
+      arrayOpen.file = resolveReferenceName(filePath,it->second);
+      return true;
+   }
+
+   /** Load subfile information of an array to arrayOpen. The table of subfile 
+    * segments is not read here, see readSubfileTable.
+    * @param node XML tag of the array.
+    * @return If true, subfile information was loaded successfully.*/
+   bool Reader::loadArraySubfiles(muxml::XMLNode* node) {
+      arrayOpen.subfiles = 0;
+      arrayOpen.subfileTable.clear();
+
+      map<string,string>::const_iterator it = node->attributes.find("subfiles");
+      if (it == node->attributes.end()) return true;
+      arrayOpen.subfiles = atol(it->second.c_str());
+      return true;
+   }
+
+   /** Memory map the input file if memory mapping is enabled, see setMemoryMapping. 
+    * If the file cannot be mapped, data is read through the file stream.*/
+   void Reader::mapFile() {
+      #ifndef WINDOWS
+         if (memoryMapping == false) return;
+         const int fd = ::open(filePath.c_str(),O_RDONLY);
+         if (fd < 0) return;
+         struct stat fileStat;
+         if (fstat(fd,&fileStat) == 0 && fileStat.st_size > 0) {
+            void* ptr = mmap(NULL,fileStat.st_size,PROT_READ,MAP_SHARED,fd,0);
+            if (ptr != MAP_FAILED) {
+               mapping = static_cast<char*>(ptr);
+               mappingBytes = fileStat.st_size;
+
+               // Arrays are accessed in the order the user reads them, 
+               // readahead is requested per array in getMappedArray:
+               madvise(mapping,mappingBytes,MADV_RANDOM);
+            }
+         }
+         ::close(fd);
+      #endif
+   }
+
    /** Open a VLSV file for reading. This function fails if a 
     * file is already open. 
     * @param fname File name.
@@ -181,7 +549,9 @@ namespace vlsv {
 
       if (filein.good() == true) {
          fileName = fnameWithoutPath;
+         filePath = fname;
          fileOpen = true;
+         verifiedArrays.clear();
       } else {
          filein.close();
          success = false;
@@ -199,22 +569,241 @@ namespace vlsv {
       filein.read(ptr,1);
       if (endiannessFile != endiannessReader) swapIntEndianness = true;
 
-      // Read footer offset:
-      uint64_t footerOffset;
+      // Read footer index offset and footer offset:
       char buffer[16];
-      filein.seekg(8);
-      filein.read(buffer,8);
-      footerOffset = convUInt64(buffer,swapIntEndianness);
+      filein.seekg(0);
+      filein.read(buffer,16);
+      footerOffset = convUInt64(buffer+8,swapIntEndianness);
    
-      // Read footer XML tree:
-      filein.seekg(footerOffset);
-      xmlReader.read(filein);
+      // Read footer XML tree. File that is still being written has no footer 
+      // until the writer commits a footer snapshot, see Reader::refresh:
+      mapFile();
+      if (footerOffset < 2*sizeof(uint64_t)) {
+         footerOffset = 0;
+         indexFooter();
+      } else {
+         readFooter(getFooterIndexOffset(buffer),footerOffset,0);
+      }
       filein.clear();
       filein.seekg(16);
       
       return success;
    }
 
+   /** Parse the XML footer starting at the given offset. The footer is parsed directly 
+    * from the memory mapping if it is inside it, otherwise it is read from the file.
+    * @param offset File offset of the footer.
+    * @param footer XML tree in which the footer is parsed.
+    * @return If true, the footer was parsed successfully.*/
+   bool Reader::parseFooter(const uint64_t& offset,muxml::MuXML& footer) {
+      bool success = false;
+      if (mapping != NULL && offset < mappingBytes) {
+         success = footer.parse(mapping+offset,mappingBytes-offset);
+      }
+      if (success == false) {
+         vector<char> buffer;
+         filein.clear();
+         filein.seekg(offset);
+         success = footer.parse(filein,buffer);
+         filein.clear();
+      }
+      return success;
+   }
+
+   /** Read the footer starting at the given offset and build the footer index. 
+    * The footer is loaded from its binary index if the file has a valid index, 
+    * otherwise the XML footer is parsed, see parseFooter. A footer snapshot that only 
+    * contains the tags written after the previous snapshot is merged with the previous 
+    * snapshots, see footersnapshot in vlsv_common.h. If the chain of snapshots reaches 
+    * the footer that has already been read, only the newer snapshots are parsed and 
+    * their tags are added to the current footer. The current footer is kept if the 
+    * footer cannot be parsed.
+    * @param indexOffset File offset of the binary footer index, zero if the file has no index.
+    * @param offset File offset of the footer.
+    * @param loadedOffset File offset of the footer that has been read, zero if none.
+    * @return If true, the footer was read successfully.*/
+   bool Reader::readFooter(const uint64_t& indexOffset,const uint64_t& offset,const uint64_t& loadedOffset) {
+      if (indexOffset != 0 && readFooterIndex(indexOffset,offset) == true) return true;
+
+      // Snapshots are parsed newest first until a complete footer, or the footer 
+      // that has already been read, is reached:
+      bool success = true;
+      bool extend = false;
+      vector<muxml::MuXML*> snapshots;
+      uint64_t snapshotOffset = offset;
+      while (true) {
+         muxml::MuXML* snapshot = new muxml::MuXML();
+         snapshots.push_back(snapshot);
+         if (parseFooter(snapshotOffset,*snapshot) == false) {
+            success = false; break;
+         }
+         const uint64_t previousOffset = getPreviousFooterOffset(*snapshot);
+         if (previousOffset == 0) break;
+
+         // Snapshots are written in file order, thus the chain cannot loop:
+         if (previousOffset >= snapshotOffset) {
+            success = false; break;
+         }
+         if (previousOffset == loadedOffset) {
+            extend = true; break;
+         }
+         snapshotOffset = previousOffset;
+      }
+
+      if (success == true) {
+         if (extend == false) xmlReader.clear();
+         mergeFooterSnapshots(snapshots,xmlReader);
+         indexFooter();
+      }
+      for (size_t s=0; s<snapshots.size(); ++s) delete snapshots[s];
+      return success;
+   }
+
+   /** Load the footer from its binary index, see footerindex in vlsv_common.h. The 
+    * index is loaded with a single read, or directly from the memory mapping, and the 
+    * XML tree and footer index are built from it without parsing XML. Index is rejected 
+    * if it does not belong to the footer at the given offset, or if it is inconsistent.
+    * @param indexOffset File offset of the binary footer index.
+    * @param offset File offset of the footer.
+    * @return If true, the footer was loaded successfully. If false, the footer must be parsed.*/
+   bool Reader::readFooterIndex(const uint64_t& indexOffset,const uint64_t& offset) {
+      // Index values are stored in the byte order of the writer:
+      if (swapIntEndianness == true) return false;
+      if (indexOffset < 2*sizeof(uint64_t) || indexOffset >= offset) return false;
+      const uint64_t bytes = offset - indexOffset;
+      if (bytes < footerindex::HEADER_BYTES) return false;
+
+      vector<char> buffer;
+      const char* data = NULL;
+      if (mapping != NULL && offset <= mappingBytes) {
+         data = mapping + indexOffset;
+      } else {
+         buffer.resize(bytes);
+         filein.clear();
+         filein.seekg(indexOffset);
+         filein.read(&(buffer[0]),bytes);
+         if (filein.good() == false) {
+            filein.clear();
+            return false;
+         }
+         data = &(buffer[0]);
+      }
+
+      const size_t magicBytes = strlen(footerindex::MAGIC);
+      if (memcmp(data,footerindex::MAGIC,magicBytes) != 0) return false;
+      uint64_t header[4];
+      memcpy(header,data+magicBytes,sizeof(header));
+      const uint64_t N_tags = header[1];
+      const uint64_t N_attributes = header[2];
+      const uint64_t stringBytes = header[3];
+      if (header[0] != offset) return false;
+      if (N_tags > bytes / (footerindex::TAG_VALUES*sizeof(uint64_t))) return false;
+      if (N_attributes > bytes / (footerindex::ATTRIBUTE_VALUES*sizeof(uint64_t))) return false;
+      const uint64_t tableBytes = (N_tags*footerindex::TAG_VALUES + N_attributes*footerindex::ATTRIBUTE_VALUES)*sizeof(uint64_t);
+      if (footerindex::HEADER_BYTES + tableBytes + stringBytes != bytes) return false;
+
+      // Tables are copied out of the buffer, which is not necessarily aligned:
+      vector<uint64_t> tables(tableBytes/sizeof(uint64_t));
+      if (tables.empty() == false) memcpy(&(tables[0]),data+footerindex::HEADER_BYTES,tableBytes);
+      const uint64_t* tags = tables.empty() ? NULL : &(tables[0]);
+      const uint64_t* attributes = tags + N_tags*footerindex::TAG_VALUES;
+      const char* strings = data + footerindex::HEADER_BYTES + tableBytes;
+      if (stringBytes > 0 && strings[stringBytes-1] != '\0') return false;
+      for (uint64_t i=0; i<N_tags; ++i) {
+         const uint64_t* tag = tags + i*footerindex::TAG_VALUES;
+         if (tag[0] >= stringBytes || tag[1] >= stringBytes) return false;
+         if (tag[2] > N_attributes || tag[3] > N_attributes - tag[2]) return false;
+      }
+      for (uint64_t i=0; i<N_attributes*footerindex::ATTRIBUTE_VALUES; ++i) {
+         if (attributes[i] >= stringBytes) return false;
+      }
+
+      // Build the XML tree and the footer index. Tags are stored in the order 
+      // of the XML footer, thus each tag is inserted at the end of its siblings:
+      xmlReader.clear();
+      arrayIndex.clear();
+      arrayIndex.reserve(4*N_tags+1);
+      muxml::XMLNode* root = xmlReader.getRoot();
+      muxml::XMLNode* vlsv = new muxml::XMLNode(root);
+      root->children.insert(make_pair(string("VLSV"),vlsv));
+      ArrayEntry entry;
+      parseArrayEntry(vlsv,entry);
+      indexNode("VLSV",entry);
+
+      for (uint64_t i=0; i<N_tags; ++i) {
+         const uint64_t* tag = tags + i*footerindex::TAG_VALUES;
+         muxml::XMLNode* node = new muxml::XMLNode(vlsv);
+         node->value = strings + tag[1];
+         const uint64_t* attribute = attributes + tag[2]*footerindex::ATTRIBUTE_VALUES;
+         for (uint64_t a=0; a<tag[3]; ++a) {
+            node->attributes.insert(node->attributes.end(),make_pair(string(strings+attribute[0]),string(strings+attribute[1])));
+            attribute += footerindex::ATTRIBUTE_VALUES;
+         }
+         const string tagName = strings + tag[0];
+         vlsv->children.insert(vlsv->children.end(),make_pair(tagName,node));
+
+         entry.node = node;
+         entry.offset = tag[4];
+         entry.arraySize = tag[5];
+         entry.vectorSize = tag[6];
+         entry.dataSize = tag[7];
+         entry.validDataType = (tag[8] != 0 && tag[8] <= 1 + datatype::FLOAT);
+         entry.dataType = entry.validDataType ? static_cast<datatype::type>(tag[8]-1) : datatype::UNKNOWN;
+         indexNode(tagName,entry);
+      }
+      return true;
+   }
+
+   /** Check if the footer offset in the file header has changed since the footer 
+    * was read, and if it has, read the new footer. A file that is still being written 
+    * can be followed by calling this function periodically, newly committed arrays 
+    * can be read after it returns with updated set to true. This requires that the 
+    * writer commits footer snapshots, see Writer::setFooterInterval. Only the snapshots 
+    * written after the current footer are parsed.
+    * @param updated Set to true if a new footer was read.
+    * @return If true, the footer offset was read successfully, and the new footer if it changed.*/
+   bool Reader::refresh(bool& updated) {
+      updated = false;
+      if (fileOpen == false) return false;
+
+      char buffer[16];
+      filein.clear();
+      filein.seekg(0);
+      filein.read(buffer,16);
+      if (filein.good() == false) {
+         filein.clear();
+         return false;
+      }
+      const uint64_t newFooterOffset = convUInt64(buffer+8,swapIntEndianness);
+      if (newFooterOffset < 2*sizeof(uint64_t) || newFooterOffset == footerOffset) return true;
+
+      if (readFooter(getFooterIndexOffset(buffer),newFooterOffset,footerOffset) == false) return false;
+      footerOffset = newFooterOffset;
+      updated = true;
+      return true;
+   }
+
+   /** Parse the metadata of an array from its XML tag.
+    * @param node XML tag of the array.
+    * @param entry Variable in which the metadata is written.*/
+   void Reader::parseArrayEntry(muxml::XMLNode* node,ArrayEntry& entry) const {
+      entry.node = node;
+      entry.offset = atol(node->value.c_str());
+      entry.arraySize = getUIntAttribute(node,"arraysize");
+      entry.vectorSize = getUIntAttribute(node,"vectorsize");
+      entry.dataSize = getUIntAttribute(node,"datasize");
+      entry.dataType = datatype::UNKNOWN;
+      entry.validDataType = true;
+
+      map<string,string>::const_iterator it = node->attributes.find("datatype");
+      const string dataType = (it != node->attributes.end()) ? it->second : string();
+      if (dataType == "unknown") entry.dataType = datatype::UNKNOWN;
+      else if (dataType == "int") entry.dataType = datatype::INT;
+      else if (dataType == "uint") entry.dataType = datatype::UINT;
+      else if (dataType == "float") entry.dataType = datatype::FLOAT;
+      else entry.validDataType = false;
+   }
+
    /** Read given part of a given array from file.
     * @param tagName Name of the XML tag.
     * @param attribs List of attributes that uniquely determine the array.
@@ -233,32 +822,21 @@ namespace vlsv {
       if (amount == 0) return true;
       
       // Find tag corresponding to given array:
-      muxml::XMLNode* node = xmlReader.find(tagName,attribs);
-      if (node == NULL) {
+      ArrayEntry entry;
+      if (findArray(tagName,attribs,entry) == false) {
          cerr << "vlsv::Reader ERROR: Failed to find tag='" << tagName << "' attribs:" << endl;
          for (list<pair<string,string> >::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
             cerr << '\t' << it->first << " = '" << it->second << "'" << endl;
          }
          return false;
       }
+      muxml::XMLNode* node = entry.node;
       
       // Copy array information from tag:
-      arrayOpen.offset = atol(node->value.c_str());
-      arrayOpen.tagName = tagName;
-      arrayOpen.arraySize = atol(node->attributes["arraysize"].c_str());
-      arrayOpen.vectorSize = atol(node->attributes["vectorsize"].c_str());
-      arrayOpen.dataSize = atol(node->attributes["datasize"].c_str());
-      if (node->attributes["datatype"] == "int") arrayOpen.dataType = datatype::INT;
-      else if (node->attributes["datatype"] == "uint") arrayOpen.dataType = datatype::UINT;
-      else if (node->attributes["datatype"] == "float") arrayOpen.dataType = datatype::FLOAT;
-      else {
-         cerr << "vlsv::Reader ERROR: Unknown datatype in tag!" << endl;
-         return false;
-      }
-   
+      if (entry.validDataType == true && entry.dataType == datatype::UNKNOWN) entry.validDataType = false;
+      if (loadArrayEntry(tagName,entry) == false) return false;
       if (arrayOpen.arraySize == 0) return false;
-      if (arrayOpen.vectorSize == 0) return false;
-      if (arrayOpen.dataSize == 0) return false;
+      if (verifyOpenArrayChecksum() == false) return false;
       
       // Sanity check on values:
       if (begin + amount > arrayOpen.arraySize) {
@@ -267,9 +845,18 @@ namespace vlsv {
          return false;
       }
 
-      // Read data from file:
+      // Compressed arrays are decompressed chunk by chunk:
+      if (arrayOpen.compression != compression::NONE) return readCompressedArray(begin,amount,buffer);
+      if (arrayOpen.subfiles > 0) return readSubfiledArray(begin,amount,buffer);
+      if (arrayOpen.file.empty() == false) return readReferencedArray(begin,amount,buffer);
+
+      // Read data from the memory mapped file, or from the file stream:
       streamoff start = arrayOpen.offset + begin*arrayOpen.vectorSize*arrayOpen.dataSize;
       streamsize readBytes = amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+      if (mapping != NULL && static_cast<uint64_t>(start + readBytes) <= mappingBytes) {
+         memcpy(buffer,mapping+start,readBytes);
+         return true;
+      }
       filein.clear();
       filein.seekg(start);
       filein.read(buffer,readBytes);
@@ -290,4 +877,208 @@ namespace vlsv {
       return true;
    }
 
+   /** Read given part of the currently open compressed array. Only the 
+    * chunks that contain the requested array elements are read and decompressed.
+    * @param begin Index of the first read array element.
+    * @param amount How many array elements are read.
+    * @param buffer Buffer in which data is copied.
+    * @return If true, requested part of the array was copied to buffer.*/
+   bool Reader::readCompressedArray(const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      // Read chunk table:
+      vector<uint64_t> chunkTable(2*arrayOpen.chunks);
+      vector<char> tableBuffer(chunkTable.size()*sizeof(uint64_t));
+      if (tableBuffer.size() > 0) {
+         filein.clear();
+         filein.seekg(arrayOpen.chunkIndexOffset);
+         filein.read(&(tableBuffer[0]),tableBuffer.size());
+         if (filein.gcount() != (streamsize)tableBuffer.size()) {
+            cerr << "vlsv::Reader ERROR: Failed to read chunk table of compressed array!" << endl;
+            return false;
+         }
+      }
+      for (size_t i=0; i<chunkTable.size(); ++i) {
+         chunkTable[i] = convUInt64(&(tableBuffer[i*sizeof(uint64_t)]),swapIntEndianness);
+      }
+
+      // Read the chunks containing the requested array elements:
+      size_t firstChunk,endChunk;
+      uint64_t firstElement,byteOffset,bytes;
+      getChunkRange(chunkTable,begin,amount,firstChunk,endChunk,firstElement,byteOffset,bytes);
+      vector<char> input(bytes);
+      if (bytes > 0) {
+         filein.clear();
+         filein.seekg(arrayOpen.offset+byteOffset);
+         filein.read(&(input[0]),bytes);
+         if (filein.gcount() != (streamsize)bytes) {
+            cerr << "vlsv::Reader ERROR: Failed to read compressed chunks!" << endl;
+            return false;
+         }
+      }
+      if (bytes == 0) input.resize(1);
+      return decompressChunks(chunkTable,firstChunk,endChunk,firstElement,begin,amount,&(input[0]),buffer);
+   }
+
+
+   /** Read a part of the currently open array from the earlier file that contains its data.
+    * @param begin First read array element.
+    * @param amount Number of read array elements.
+    * @param buffer Buffer in which the data is read.
+    * @return If true, the data was read successfully.*/
+   bool Reader::readReferencedArray(const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      const uint64_t elementBytes = arrayOpen.vectorSize*arrayOpen.dataSize;
+      fstream referencedFile(arrayOpen.file.c_str(),fstream::in | fstream::binary);
+      referencedFile.seekg(arrayOpen.offset + begin*elementBytes);
+      referencedFile.read(buffer,amount*elementBytes);
+      if (referencedFile.gcount() != (streamsize)(amount*elementBytes)) {
+         cerr << "vlsv::Reader ERROR: Failed to read array data from referenced file '" << arrayOpen.file << "'!" << endl;
+         return false;
+      }
+      return true;
+   }
+
+   /** Read array elements of the currently open array that is stored in subfiles.
+    * @param begin Index of the first read array element.
+    * @param amount Number of array elements to read.
+    * @param buffer Buffer in which the array elements are written.
+    * @return If true, array elements were read successfully.*/
+   bool Reader::readSubfiledArray(const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      if (readSubfileTable() == false) return false;
+
+      // Array data is the concatenation of the segments in subfile order:
+      const uint64_t elementBytes = arrayOpen.vectorSize*arrayOpen.dataSize;
+      const uint64_t start = begin*elementBytes;
+      const uint64_t end = start + amount*elementBytes;
+      uint64_t segmentStart = 0;
+      for (uint64_t s=0; s<arrayOpen.subfiles && segmentStart<end; ++s) {
+         const uint64_t segmentEnd = segmentStart + arrayOpen.subfileTable[2*s+1];
+         if (segmentEnd > start) {
+            const uint64_t readStart = max(start,segmentStart);
+            const uint64_t readEnd = min(end,segmentEnd);
+            fstream subfile(getSubfileName(filePath,s).c_str(),fstream::in | fstream::binary);
+            subfile.seekg(arrayOpen.subfileTable[2*s] + readStart-segmentStart);
+            subfile.read(buffer + (readStart-start),readEnd-readStart);
+            if (subfile.gcount() != (streamsize)(readEnd-readStart)) {
+               cerr << "vlsv::Reader ERROR: Failed to read array data from subfile '" << getSubfileName(filePath,s) << "'!" << endl;
+               return false;
+            }
+         }
+         segmentStart = segmentEnd;
+      }
+      return true;
+   }
+
+   /** Read the table of subfile segments of the currently open array to arrayOpen.
+    * @return If true, the table was read successfully.*/
+   bool Reader::readSubfileTable() {
+      vector<char> tableBuffer(2*arrayOpen.subfiles*sizeof(uint64_t));
+      arrayOpen.subfileTable.resize(2*arrayOpen.subfiles);
+      if (tableBuffer.size() == 0) return true;
+
+      filein.clear();
+      filein.seekg(arrayOpen.offset);
+      filein.read(&(tableBuffer[0]),tableBuffer.size());
+      if (filein.gcount() != (streamsize)tableBuffer.size()) {
+         cerr << "vlsv::Reader ERROR: Failed to read subfile table of array!" << endl;
+         return false;
+      }
+      for (size_t i=0; i<arrayOpen.subfileTable.size(); ++i) {
+         arrayOpen.subfileTable[i] = convUInt64(&(tableBuffer[i*sizeof(uint64_t)]),swapIntEndianness);
+      }
+      return true;
+   }
+
+   /** Enable or disable memory mapping of input files. A memory mapped file is read 
+    * without system calls, and arrays can be accessed without copying through 
+    * ArrayView, see read. Only the part of the file that existed when it was opened 
+    * is mapped, arrays appended later are read through the file stream. Memory 
+    * mapping is not supported on Windows. The setting takes effect when the next 
+    * file is opened.
+    * @param enabled If true, input files are memory mapped.*/
+   void Reader::setMemoryMapping(const bool& enabled) {
+      memoryMapping = enabled;
+   }
+
+   /** Enable or disable checksum verification. If enabled, the checksum of each
+    * array that has one is verified when the array is read for the first time, and
+    * the read fails if the stored data does not match the checksum. Verification
+    * requires reading the whole array once.
+    * @param verify If true, checksums are verified.*/
+   void Reader::setVerifyChecksums(const bool& verify) {
+      verifyChecksums = verify;
+   }
+
+   /** Remove the memory mapping of the input file, if it exists. Views into the mapping become invalid.*/
+   void Reader::unmapFile() {
+      #ifndef WINDOWS
+         if (mapping != NULL) munmap(mapping,mappingBytes);
+      #endif
+      mapping = NULL;
+      mappingBytes = 0;
+   }
+
+   /** Verify the checksum of the given array.
+    * @param tagName Name of the XML tag of the array.
+    * @param attribs Attributes of the array.
+    * @return If true, array was found and either has no checksum or its checksum is correct.*/
+   bool Reader::verifyArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) {
+      if (loadArray(tagName,attribs) == false) return false;
+      if (arrayOpen.hasChecksum == false) return true;
+      return verifyFileChecksum(arrayOpen.offset,getStoredBytes(),arrayOpen.checksum);
+   }
+
+   /** Verify the checksums of all arrays in the file that have a checksum.
+    * @param arraysVerified Number of arrays whose checksums were verified.
+    * @param failedArrays Descriptions of arrays whose checksums did not match.
+    * @return If true, all checksums were correct.*/
+   bool Reader::verifyArrays(uint64_t& arraysVerified,std::vector<std::string>& failedArrays) {
+      arraysVerified = 0;
+      failedArrays.clear();
+      if (fileOpen == false) return false;
+
+      vector<string> names;
+      vector<uint64_t> checksums;
+      getChecksummedArrays(names,checksums);
+      for (size_t a=0; a<names.size(); ++a) {
+         if (verifyFileChecksum(checksums[3*a+0],checksums[3*a+1],checksums[3*a+2]) == false) failedArrays.push_back(names[a]);
+         ++arraysVerified;
+      }
+      return failedArrays.size() == 0;
+   }
+
+   /** Compute the checksum of a region of the file and compare it to the given checksum.
+    * @param offset File offset of the region.
+    * @param bytes Number of bytes in the region.
+    * @param checksum Expected checksum.
+    * @return If true, the region could be read and the checksums match.*/
+   bool Reader::verifyFileChecksum(const uint64_t& offset,const uint64_t& bytes,const uint32_t& checksum) {
+      if (mapping != NULL && offset + bytes <= mappingBytes) return crc32c(0,mapping+offset,bytes) == checksum;
+
+      const uint64_t blockBytes = 4*1024*1024;
+      vector<char> block(min(bytes,blockBytes)+1);
+      uint32_t crc = 0;
+      filein.clear();
+      filein.seekg(offset);
+      for (uint64_t b=0; b<bytes; b+=blockBytes) {
+         const streamsize readBytes = min(bytes-b,blockBytes);
+         filein.read(&(block[0]),readBytes);
+         if (filein.gcount() != readBytes) return false;
+         crc = crc32c(crc,&(block[0]),readBytes);
+      }
+      return crc == checksum;
+   }
+
+   /** Verify the checksum of the currently open array, if checksum verification is
+    * enabled and the array has a checksum. Each array is verified only once.
+    * @return If false, checksum of the array did not match the stored data.*/
+   bool Reader::verifyOpenArrayChecksum() {
+      if (verifyChecksums == false || arrayOpen.hasChecksum == false) return true;
+      if (verifiedArrays.find(arrayOpen.offset) != verifiedArrays.end()) return true;
+      if (verifyFileChecksum(arrayOpen.offset,getStoredBytes(),arrayOpen.checksum) == false) {
+         cerr << "vlsv::Reader ERROR: Checksum mismatch in array '" << arrayOpen.tagName << "' at offset " << arrayOpen.offset << endl;
+         return false;
+      }
+      verifiedArrays.insert(arrayOpen.offset);
+      return true;
+   }
+
 } // namespace vlsv
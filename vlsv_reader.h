@@ -22,6 +22,9 @@
 #include <stdint.h>
 #include <list>
 #include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 #include <fstream>
 
 #include "muxml.h"
@@ -29,6 +32,39 @@
 
 namespace vlsv {
 
+   /** Typed read-only view of a part of an array, see Reader::read. If the file is 
+    * memory mapped and the stored datatype matches T, the view points directly 
+    * into the mapping and is valid until the file is closed. Otherwise the view 
+    * owns a converted copy of the data.*/
+   template<typename T>
+   class ArrayView {
+    public:
+      ArrayView(): elements(0),mapped(NULL),vectorElements(0) { }
+
+      /** Get a vector component with bounds checking.
+       * @param element Index of the array element in the view.
+       * @param component Index of the component in the data vector.
+       * @return Reference to the value, std::out_of_range is thrown if the index is invalid.*/
+      const T& at(const uint64_t& element,const uint64_t& component=0) const {
+         if (element >= elements || component >= vectorElements) throw std::out_of_range("vlsv::ArrayView::at");
+         return data()[element*vectorElements+component];
+      }
+      void clear() {elements = 0; mapped = NULL; vectorElements = 0; storage.clear();}
+      const T* data() const {return (mapped != NULL) ? mapped : (storage.empty() ? NULL : &(storage[0]));}
+      bool isMapped() const {return mapped != NULL;}
+      uint64_t size() const {return elements;}
+      uint64_t vectorSize() const {return vectorElements;}
+      const T& operator[](const uint64_t& i) const {return data()[i];}
+
+    private:
+      friend class Reader;
+
+      uint64_t elements;      /**< Number of array elements in the view.*/
+      const T* mapped;        /**< Pointer to the data in the memory mapped file, NULL if the data was converted.*/
+      std::vector<T> storage; /**< Converted data, used if the data could not be viewed in place.*/
+      uint64_t vectorElements; /**< Number of components in the data vector of each array element.*/
+   };
+
    class Reader {
     public:
       Reader();
@@ -45,20 +81,48 @@ namespace vlsv {
       virtual bool open(const std::string& fname);
       virtual bool readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                              const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool refresh(bool& updated);
+      void setMemoryMapping(const bool& enabled);
+      void setVerifyChecksums(const bool& verify);
+      virtual bool verifyArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs);
+      virtual bool verifyArrays(uint64_t& arraysVerified,std::vector<std::string>& failedArrays);
 
       template<typename T>
       bool read(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                 const uint64_t& begin,const uint64_t& amount,T*& buffer,bool allocateMemory=true);
       template<typename T>
+      bool read(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                const uint64_t& begin,const uint64_t& amount,ArrayView<T>& view);
+      template<typename T>
       bool readParameter(const std::string& parameterName,T& value);
    
     protected:
+      /** Metadata of an array parsed from its XML tag, see indexFooter.*/
+      struct ArrayEntry {
+         muxml::XMLNode* node;            /**< XML tag of the array.*/
+         uint64_t offset;                 /**< File offset of the array.*/
+         uint64_t arraySize;              /**< Number of array elements.*/
+         uint64_t vectorSize;             /**< Size of the data vector in each array element.*/
+         uint64_t dataSize;               /**< Byte size of the primitive datatype.*/
+         datatype::type dataType;         /**< Datatype of the array.*/
+         bool validDataType;              /**< If false, the datatype string in the tag was not recognized.*/
+      };
+
+      std::unordered_map<std::string,ArrayEntry> arrayIndex; /**< Arrays in the footer indexed by tag name and 
+                                                              * name and mesh attributes, see indexFooter.*/
       unsigned char endiannessFile;   /**< Endianness in VLSV file.*/
       unsigned char endiannessReader; /**< Endianness of computer which reads the data.*/
       std::fstream filein;            /**< Input file stream.*/
       std::string fileName;           /**< Name of the input file.*/
+      std::string filePath;           /**< Name of the input file including path, used to locate subfiles.*/
       bool fileOpen;                  /**< If true, a file is currently open.*/
+      uint64_t footerOffset;          /**< Offset of the footer that was read, zero if the file has no footer yet.*/
+      char* mapping;                  /**< Memory mapping of the input file, NULL if the file is not mapped.*/
+      uint64_t mappingBytes;          /**< Size of the memory mapping in bytes.*/
+      bool memoryMapping;             /**< If true, the input file is memory mapped when it is opened.*/
       bool swapIntEndianness;         /**< If true, endianness should be swapped on read data (not implemented yet).*/
+      std::set<std::streamoff> verifiedArrays; /**< Offsets of arrays whose checksums have been verified.*/
+      bool verifyChecksums;           /**< If true, checksum of each array is verified when the array is read for the first time.*/
       muxml::MuXML xmlReader;         /**< XML reader used to parse VLSV footer.*/
    
       /** Struct used to store information on the currently open array.*/
@@ -70,7 +134,50 @@ namespace vlsv {
          uint64_t arraySize;
          uint64_t vectorSize;
          uint64_t dataSize;
+         compression::type compression;   /**< Compression method, compression::NONE if array is uncompressed.*/
+         uint64_t chunks;                 /**< Number of compressed chunks in the array.*/
+         std::streamoff chunkIndexOffset; /**< File offset of the chunk table of a compressed array.*/
+         bool hasChecksum;                /**< If true, the array has a checksum in the footer.*/
+         uint32_t checksum;               /**< CRC32C checksum of the stored array, see vlsv_checksum.h.*/
+         uint64_t subfiles;               /**< Number of subfiles the array is stored in, zero if the 
+                                           * array is stored in the VLSV file, see Writer::setSubfiles.*/
+         std::vector<uint64_t> subfileTable; /**< Offset and size of the array's segment in each subfile.*/
+         std::string file;                /**< Name of the file containing the array data if the array is a 
+                                           * reference to an earlier file, otherwise empty, see Writer::setHistory.*/
       } arrayOpen;
+
+      bool decompressChunks(const std::vector<uint64_t>& chunkTable,const size_t& firstChunk,const size_t& endChunk,
+                            const uint64_t& firstElement,const uint64_t& begin,const uint64_t& amount,
+                            const char* input,char* buffer) const;
+      bool findArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                     ArrayEntry& entry) const;
+      void getChunkRange(const std::vector<uint64_t>& chunkTable,const uint64_t& begin,const uint64_t& amount,
+                         size_t& firstChunk,size_t& endChunk,uint64_t& firstElement,uint64_t& byteOffset,uint64_t& bytes) const;
+      void getChecksummedArrays(std::vector<std::string>& names,std::vector<uint64_t>& checksums);
+      const char* getMappedArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                                 const uint64_t& begin,const uint64_t& amount,const std::string& dataType,
+                                 const uint64_t& dataSize,uint64_t& vectorSize);
+      uint64_t getStoredBytes() const;
+      void indexFooter();
+      void indexNode(const std::string& tagName,const ArrayEntry& entry);
+      void indexNodes(const muxml::XMLNode* parent);
+      bool loadArrayChecksum(muxml::XMLNode* node);
+      bool loadArrayCompression(muxml::XMLNode* node);
+      bool loadArrayEntry(const std::string& tagName,const ArrayEntry& entry);
+      bool loadArrayReference(muxml::XMLNode* node);
+      bool loadArraySubfiles(muxml::XMLNode* node);
+      void mapFile();
+      void parseArrayEntry(muxml::XMLNode* node,ArrayEntry& entry) const;
+      bool parseFooter(const uint64_t& offset,muxml::MuXML& footer);
+      bool readCompressedArray(const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool readFooter(const uint64_t& indexOffset,const uint64_t& offset,const uint64_t& loadedOffset);
+      bool readFooterIndex(const uint64_t& indexOffset,const uint64_t& offset);
+      bool readReferencedArray(const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool readSubfiledArray(const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool readSubfileTable();
+      void unmapFile();
+      bool verifyFileChecksum(const uint64_t& offset,const uint64_t& bytes,const uint32_t& checksum);
+      bool verifyOpenArrayChecksum();
    };
 
    template<typename T> inline
@@ -83,9 +190,9 @@ namespace vlsv {
       // Get array info:
       uint64_t arraySize;
       uint64_t vectorSize;
-      datatype::type datatype;
+      datatype::type dataType;
       uint64_t dataSize;
-      if (Reader::getArrayInfo(tagName,attribs,arraySize,vectorSize,datatype,dataSize) == false) {
+      if (Reader::getArrayInfo(tagName,attribs,arraySize,vectorSize,dataType,dataSize) == false) {
          std::cerr << "vlsv::Reader failed to get array info" << std::endl;
          return false;
       }
@@ -93,24 +200,63 @@ namespace vlsv {
       // Check that requested read is inside the array:
       if (begin > arraySize || (begin+amount) > arraySize) return false;
 
-      // Read data into temporary buffer:
-      char* buffer = new char[amount*vectorSize*dataSize];
-      if (Reader::readArray(tagName,attribs,begin,amount,buffer) == false) {
-         delete [] buffer; buffer = NULL;
-         return false;
-      }
+      // If the stored datatype is not larger than T, data is read into the end of output 
+      // buffer and converted in place, i.e., data stored as T is read directly into output 
+      // buffer. Otherwise data is read into a temporary buffer:
+      const uint64_t N_values = amount*vectorSize;
+      const bool inPlace = (dataType == datatype::UNKNOWN) ? (dataSize == sizeof(T)) : (dataSize <= sizeof(T));
+      if (allocateMemory == true) outBuffer = new T[N_values];
+      char* buffer = NULL;
+      if (inPlace == true) buffer = reinterpret_cast<char*>(outBuffer) + N_values*(sizeof(T)-dataSize);
+      else buffer = new char[N_values*dataSize];
 
-      // Copy data from temporary buffer to output:
-      if (allocateMemory == true) outBuffer = new T[amount*vectorSize];
-      char* ptr = buffer;
-      for (uint64_t i=0; i<amount; ++i) {
-         for (uint64_t j=0; j<vectorSize; ++j) {
-            convertValue<T>(outBuffer[i*vectorSize+j],ptr,datatype,dataSize,false);	 
-            ptr += dataSize;
-         }
+      bool success = Reader::readArray(tagName,attribs,begin,amount,buffer);
+      if (success == true) success = convertArray<T>(outBuffer,buffer,dataType,dataSize,N_values);
+      if (inPlace == false) {delete [] buffer; buffer = NULL;}
+      if (success == false && allocateMemory == true) {delete [] outBuffer; outBuffer = NULL;}
+      return success;
+   }
+
+   /** Read given part of a given array as a typed view. If the file is memory mapped, 
+    * see setMemoryMapping, and the array is stored uncompressed in the input file as 
+    * datatype T, the view points directly into the mapping and no data is copied. 
+    * Otherwise the data is read and converted to T as in the other read functions.
+    * @param tagName Name of the XML tag.
+    * @param attribs List of attributes that uniquely determine the array.
+    * @param begin Index of the first array element in the view.
+    * @param amount Number of array elements in the view.
+    * @param view View in which the data is stored.
+    * @return If true, the view contains the requested part of the array.*/
+   template<typename T> inline
+   bool Reader::read(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
+                     const uint64_t& begin,const uint64_t& amount,ArrayView<T>& view) {
+      view.clear();
+      uint64_t vectorSize;
+      const char* ptr = getMappedArray(tagName,attribs,begin,amount,getStringDatatype<T>(),sizeof(T),vectorSize);
+      if (ptr != NULL) {
+         view.elements = amount;
+         view.mapped = reinterpret_cast<const T*>(ptr);
+         view.vectorElements = vectorSize;
+         return true;
       }
 
-      delete [] buffer; buffer = NULL;
+      // Data could not be viewed in place, it is converted into the view's own storage:
+      uint64_t arraySize;
+      datatype::type dataType;
+      uint64_t dataSize;
+      if (Reader::getArrayInfo(tagName,attribs,arraySize,vectorSize,dataType,dataSize) == false) return false;
+      if (amount == 0) {
+         view.vectorElements = vectorSize;
+         return true;
+      }
+      view.storage.resize(amount*vectorSize);
+      T* buffer = &(view.storage[0]);
+      if (Reader::read(tagName,attribs,begin,amount,buffer,false) == false) {
+         view.clear();
+         return false;
+      }
+      view.elements = amount;
+      view.vectorElements = vectorSize;
       return true;
    }
 
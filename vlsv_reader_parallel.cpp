@@ -20,7 +20,10 @@
 #include <iostream>
 #include <string.h>
 
+#include "vlsv_checksum.h"
 #include "vlsv_common_mpi.h"
+#include "vlsv_compression.h"
+#include "vlsv_hints.h"
 #include "vlsv_reader_parallel.h"
 
 using namespace std;
@@ -29,6 +32,7 @@ namespace vlsv {
 
    /** Default constructor for class ParallelReader.*/
    ParallelReader::ParallelReader(): Reader() {
+      ioStrategy = iostrategy::AUTO;
       multireadStarted = false;
    }
    
@@ -102,16 +106,39 @@ namespace vlsv {
       if (multireadStarted == false) success = false;
       if (checkSuccess(success,comm) == false) return false;
 
+      // Compressed arrays, arrays stored in subfiles, and references to earlier files are 
+      // read to a temporary buffer, and the data is then copied to multi-read units:
+      if (arrayOpen.compression != compression::NONE || arrayOpen.subfiles > 0 || arrayOpen.file.empty() == false) {
+         const uint64_t bytes = multiReadUnits.getBytes();
+         const uint64_t start = arrayOffset*arrayOpen.vectorSize*arrayOpen.dataSize;
+         vector<char> buffer(bytes+1);
+         if (arrayOpen.compression != compression::NONE) {
+            if (readChunks(arrayOffset,bytes/(arrayOpen.vectorSize*arrayOpen.dataSize),&(buffer[0])) == false) success = false;
+         } else if (arrayOpen.subfiles > 0) {
+            if (readSubfileBytes(start,bytes,&(buffer[0])) == false) success = false;
+         } else {
+            if (readExternalBytes(arrayOpen.file,arrayOpen.offset+start,bytes,&(buffer[0])) == false) success = false;
+         }
+
+         uint64_t bufferOffset = 0;
+         for (Multi_IO_Buffer::const_iterator it=multiReadUnits.begin(); it!=multiReadUnits.end(); ++it) {
+            memcpy(it->array,&(buffer[bufferOffset]),it->amount*arrayOpen.dataSize);
+            bufferOffset += it->amount*arrayOpen.dataSize;
+         }
+         multireadStarted = false;
+         return checkSuccess(success,comm);
+      }
+
       // Calculate how many collective MPI calls are needed to 
       // read all the data from input file:
       size_t inputBytesize    = 0;
       size_t myCollectiveCalls = 0;
       if (multiReadUnits.size() > 0) myCollectiveCalls = 1;
 
-      vector<pair<list<Multi_IO_Unit>::iterator,list<Multi_IO_Unit>::iterator> > multireadList;
-      list<Multi_IO_Unit>::iterator first = multiReadUnits.begin();
-      list<Multi_IO_Unit>::iterator last  = multiReadUnits.begin();
-      for (list<Multi_IO_Unit>::iterator it=multiReadUnits.begin(); it!=multiReadUnits.end(); ++it) {
+      vector<pair<Multi_IO_Buffer::iterator,Multi_IO_Buffer::iterator> > multireadList;
+      Multi_IO_Buffer::iterator first = multiReadUnits.begin();
+      Multi_IO_Buffer::iterator last  = multiReadUnits.begin();
+      for (Multi_IO_Buffer::iterator it=multiReadUnits.begin(); it!=multiReadUnits.end(); ++it) {
          if (inputBytesize + it->amount*arrayOpen.dataSize > getMaxBytesPerRead()) {
             multireadList.push_back(make_pair(first,last));
             first = it; last = it;
@@ -144,7 +171,7 @@ namespace vlsv {
 
       for (size_t i=0; i<multireadList.size(); ++i) {
          if (flushMultiread(i,unitOffset,multireadList[i].first,multireadList[i].second) == false) success = false;
-         for (std::list<Multi_IO_Unit>::iterator it=multireadList[i].first; it!=multireadList[i].second; ++it) {
+         for (Multi_IO_Buffer::iterator it=multireadList[i].first; it!=multireadList[i].second; ++it) {
             unitOffset += it->amount*arrayOpen.dataSize;
          }
       }
@@ -158,10 +185,15 @@ namespace vlsv {
     * @see vlsv::ParallelReader::open().*/
    bool ParallelReader::close() {
       multireadStarted = false;
+      verifiedArrays.clear();
       if (parallelFileOpen == true) {
          MPI_File_close(&filePtr);
          parallelFileOpen = false;
       }
+      for (map<string,MPI_File>::iterator it=externalFiles.begin(); it!=externalFiles.end(); ++it) {
+         MPI_File_close(&(it->second));
+      }
+      externalFiles.clear();
 
       if (myRank == masterRank) filein.close();
       return true;
@@ -248,6 +280,40 @@ namespace vlsv {
       MPI_Bcast(&arrayOpen.vectorSize,1,MPI_Type<uint64_t>(), masterRank,comm);
       MPI_Bcast(&arrayOpen.dataType,  1,MPI_Type<int>(),      masterRank,comm);
       MPI_Bcast(&arrayOpen.dataSize,  1,MPI_Type<uint64_t>(), masterRank,comm);
+
+      // Broadcast compression, checksum, subfile, and reference information:
+      uint64_t compressionInfo[7];
+      compressionInfo[0] = arrayOpen.compression;
+      compressionInfo[1] = arrayOpen.chunks;
+      compressionInfo[2] = arrayOpen.chunkIndexOffset;
+      compressionInfo[3] = arrayOpen.hasChecksum;
+      compressionInfo[4] = arrayOpen.checksum;
+      compressionInfo[5] = arrayOpen.subfiles;
+      compressionInfo[6] = arrayOpen.file.size();
+      MPI_Bcast(compressionInfo,7,MPI_Type<uint64_t>(),masterRank,comm);
+      arrayOpen.compression      = static_cast<compression::type>(compressionInfo[0]);
+      arrayOpen.chunks           = compressionInfo[1];
+      arrayOpen.chunkIndexOffset = compressionInfo[2];
+      arrayOpen.hasChecksum      = (compressionInfo[3] != 0);
+      arrayOpen.checksum         = compressionInfo[4];
+      arrayOpen.subfiles         = compressionInfo[5];
+      arrayOpen.file.resize(compressionInfo[6]);
+      if (arrayOpen.file.size() > 0) {
+         MPI_Bcast(&(arrayOpen.file[0]),arrayOpen.file.size(),MPI_CHAR,masterRank,comm);
+      }
+
+      // Master reads the table of subfile segments and broadcasts it to all processes. 
+      // First element tells if master read the table successfully:
+      if (arrayOpen.subfiles > 0) {
+         vector<uint64_t> subfileTable(2*arrayOpen.subfiles+1);
+         if (myRank == masterRank) {
+            subfileTable[0] = (readSubfileTable() == true) ? 0 : 1;
+            copy(arrayOpen.subfileTable.begin(),arrayOpen.subfileTable.end(),subfileTable.begin()+1);
+         }
+         MPI_Bcast(&(subfileTable[0]),subfileTable.size(),MPI_Type<uint64_t>(),masterRank,comm);
+         if (subfileTable[0] != 0) return false;
+         arrayOpen.subfileTable.assign(subfileTable.begin()+1,subfileTable.end());
+      }
       return success;
    }
 
@@ -328,51 +394,34 @@ namespace vlsv {
    }
 
    bool ParallelReader::flushMultiread(const size_t& unit,const MPI_Offset& fileOffset,
-                                       std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop) {
+                                       Multi_IO_Buffer::iterator& start,Multi_IO_Buffer::iterator& stop) {
       bool success = true;
       
-      // Count the number of multi-read units read:
-      size_t N_multiReadUnits = 0;
-      for (list<Multi_IO_Unit>::iterator it=start; it!=stop; ++it) {
-         ++N_multiReadUnits;
-      }
-
-      // Create an MPI datatype for reading all units with a single collective call:
-      int* blockLengths       = new int[N_multiReadUnits];
-      MPI_Aint* displacements = new MPI_Aint[N_multiReadUnits];
-      MPI_Datatype* datatypes = new MPI_Datatype[N_multiReadUnits];
-
-      char* multireadOffsetPointer = NULL;
-      if (N_multiReadUnits > 0) multireadOffsetPointer = start->array;
-      
-      // Copy pointers etc. to MPI struct:
-      size_t i=0;
-      size_t amount = 0;
-      for (list<Multi_IO_Unit>::iterator it=start; it!=stop; ++it) {
-         blockLengths[i]  = it->amount;
-         displacements[i] = it->array - multireadOffsetPointer;
-         datatypes[i]     = it->mpiType;
-
-         int datatypeBytesize;
-         MPI_Type_size(it->mpiType,&datatypeBytesize);
-         amount += it->amount * datatypeBytesize;
-
-         ++i;
-      }
+      const size_t N_multiReadUnits = stop - start;
+      const uint64_t amount = getUnitBytes(start,stop);
 
       // Read data from file:
       if (N_multiReadUnits > 0) {
-         // Create an MPI struct containing the multiread units:
-         MPI_Datatype inputType;
-         MPI_Type_create_struct(N_multiReadUnits,blockLengths,displacements,datatypes,&inputType);
-         MPI_Type_commit(&inputType);
-
-         // Read data from output file with a single collective call:
-         const double t_start = MPI_Wtime();
-         MPI_File_read_at_all(filePtr,fileOffset,multireadOffsetPointer,1,inputType,MPI_STATUS_IGNORE);
-         readTime += (MPI_Wtime() - t_start);
-         MPI_Type_free(&inputType);
-         
+         char* multireadOffsetPointer = start->array;
+         const iostrategy::type strategy = selectIOStrategy(ioStrategy,start,stop,amount,true);
+         if (strategy == iostrategy::PACK) {
+            // Read data to a staging buffer that is reused by subsequent flushes, and copy it to units:
+            if (stagingBuffer.size() < amount) stagingBuffer.resize(amount);
+            const double t_start = MPI_Wtime();
+            if (MPI_File_read_at_all(filePtr,fileOffset,&(stagingBuffer[0]),amount,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            readTime += (MPI_Wtime() - t_start);
+            unpackUnits(&(stagingBuffer[0]),start,stop);
+         } else {
+            // Create an MPI datatype containing the multiread units. The arrays 
+            // used to create the datatype are reused by subsequent flushes:
+            MPI_Datatype inputType = createUnitDatatype(strategy,start,stop,blockLengths,displacements,datatypes);
+
+            // Read data from output file with a single collective call:
+            const double t_start = MPI_Wtime();
+            if (MPI_File_read_at_all(filePtr,fileOffset,multireadOffsetPointer,1,inputType,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            readTime += (MPI_Wtime() - t_start);
+            MPI_Type_free(&inputType);
+         }
          bytesRead += amount;
       } else {
          // Process has no data to read but needs to participate in the collective call to prevent deadlock:
@@ -380,13 +429,24 @@ namespace vlsv {
          MPI_File_read_at_all(filePtr,fileOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE);
          readTime += (MPI_Wtime() - t_start);
       }
-
-      delete [] blockLengths;
-      delete [] displacements;
-      delete [] datatypes;
       return success;
    }
 
+   /** Set the hint cache from which MPI-IO hints tuned for the current job geometry 
+    * are loaded when a file is opened, see Writer::setHintCache. This function 
+    * must be called by all processes before open.
+    * @param fileName Name of the hint cache file, empty string disables the cache.*/
+   void ParallelReader::setHintCache(const std::string& fileName) {
+      hintCache = fileName;
+   }
+
+   /** Set the method used to transfer multi-read units to MPI in a single collective 
+    * read, see Writer::setIOStrategy.
+    * @param strategy Transfer method.*/
+   void ParallelReader::setIOStrategy(const iostrategy::type& strategy) {
+      ioStrategy = strategy;
+   }
+
    /** Open a VLSV file for parallel reading.
     * @param fname Name of the VLSV file.
     * @param comm MPI communicator used in collective MPI operations.
@@ -401,11 +461,15 @@ namespace vlsv {
       MPI_Comm_size(comm,&processes);
       multireadStarted = false;
 
-      // Attempt to open the given input file using MPI:
+      // Attempt to open the given input file using MPI. Tuned hints 
+      // from the hint cache are added to mpiInfo, see setHintCache:
       fileName = fname;
       int accessMode = MPI_MODE_RDONLY;
-      if (MPI_File_open(comm,const_cast<char*>(fileName.c_str()),accessMode,mpiInfo,&filePtr) != MPI_SUCCESS) success = false;
+      MPI_Info fileInfo = mpiInfo;
+      if (hintCache.empty() == false) loadTunedHints(hintCache,comm,mpiInfo,fileInfo);
+      if (MPI_File_open(comm,const_cast<char*>(fileName.c_str()),accessMode,fileInfo,&filePtr) != MPI_SUCCESS) success = false;
       else parallelFileOpen = true;
+      if (fileInfo != mpiInfo) MPI_Info_free(&fileInfo);
       
       if (success == false) cerr << "Failed to open parallel file" << endl;
       
@@ -428,6 +492,7 @@ namespace vlsv {
       
       // Broadcast file endianness to all processes:
       MPI_Bcast(&endiannessFile,1,MPI_Type<unsigned char>(),masterRank,comm);
+      swapIntEndianness = (endiannessFile != endiannessReader);
 
       bytesRead = 0;
       return success;
@@ -457,8 +522,91 @@ namespace vlsv {
 
       // Fetch array info to all processes:
       if (getArrayInfo(tagName,attribs) == false) return false;
+      if (verifyOpenArrayChecksum() == false) return false;
+
+      // Compressed arrays are decompressed chunk by chunk:
+      if (arrayOpen.compression != compression::NONE) {
+         if (readChunks(begin,amount,buffer) == false) success = false;
+         return checkSuccess(success,comm);
+      }
+
+      // Arrays stored in subfiles are read with independent reads from each subfile:
+      if (arrayOpen.subfiles > 0) {
+         const uint64_t elementBytes = arrayOpen.vectorSize*arrayOpen.dataSize;
+         if (readSubfileBytes(begin*elementBytes,amount*elementBytes,buffer) == false) success = false;
+         return checkSuccess(success,comm);
+      }
+
+      // References to earlier files are read with independent reads from the referenced file:
+      if (arrayOpen.file.empty() == false) {
+         const uint64_t elementBytes = arrayOpen.vectorSize*arrayOpen.dataSize;
+         if (readExternalBytes(arrayOpen.file,arrayOpen.offset+begin*elementBytes,amount*elementBytes,buffer) == false) success = false;
+         return checkSuccess(success,comm);
+      }
+
       const MPI_Offset start = arrayOpen.offset + begin*arrayOpen.vectorSize*arrayOpen.dataSize;
       const size_t readBytes = amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+      if (readFileBytes(start,readBytes,buffer) == false) success = false;
+
+      return checkSuccess(success,comm);
+   }
+
+   /** Read the chunks of the currently open compressed array that contain the 
+    * given array elements, and decompress them. The chunk table is read by master 
+    * process, who broadcasts it to all processes. This function must be called 
+    * by all processes.
+    * @param begin Index of the first array element read by this process.
+    * @param amount Number of array elements read by this process.
+    * @param buffer Buffer in which the array elements are written.
+    * @return If true, this process read its data successfully.*/
+   bool ParallelReader::readChunks(const uint64_t& begin,const uint64_t& amount,char* buffer) {
+      bool success = true;
+
+      // Master reads the chunk table and broadcasts it to all processes. 
+      // First element tells if master read the table successfully:
+      vector<uint64_t> chunkTable(2*arrayOpen.chunks+1);
+      if (myRank == masterRank) {
+         vector<char> tableBuffer(2*arrayOpen.chunks*sizeof(uint64_t)+1);
+         MPI_Status status;
+         int bytesReceived = 0;
+         chunkTable[0] = 1;
+         if (MPI_File_read_at(filePtr,arrayOpen.chunkIndexOffset,&(tableBuffer[0]),tableBuffer.size()-1,MPI_BYTE,&status) == MPI_SUCCESS) {
+            MPI_Get_count(&status,MPI_BYTE,&bytesReceived);
+            if (bytesReceived == (int)tableBuffer.size()-1) chunkTable[0] = 0;
+         }
+         for (size_t i=1; i<chunkTable.size(); ++i) {
+            chunkTable[i] = convUInt64(&(tableBuffer[(i-1)*sizeof(uint64_t)]),swapIntEndianness);
+         }
+      }
+      MPI_Bcast(&(chunkTable[0]),chunkTable.size(),MPI_Type<uint64_t>(),masterRank,comm);
+      if (chunkTable[0] != 0) {
+         cerr << "ERROR in vlsv::ParallelReader! Failed to read chunk table of compressed array" << endl;
+         success = false;
+      }
+      chunkTable.erase(chunkTable.begin());
+
+      // Read the chunks containing this process' array elements:
+      size_t firstChunk,endChunk;
+      uint64_t firstElement,byteOffset,bytes;
+      getChunkRange(chunkTable,begin,amount,firstChunk,endChunk,firstElement,byteOffset,bytes);
+      vector<char> input(bytes+1);
+      if (readFileBytes(arrayOpen.offset+byteOffset,bytes,&(input[0])) == false) success = false;
+
+      if (success == true) {
+         if (decompressChunks(chunkTable,firstChunk,endChunk,firstElement,begin,amount,&(input[0]),buffer) == false) success = false;
+      }
+      return success;
+   }
+
+   /** Read a contiguous range of bytes from the input file. If the range is larger 
+    * than getMaxBytesPerRead() this process needs more than one collective call to read 
+    * in all the data. This function must be called by all processes.
+    * @param start Offset into input file where the range starts.
+    * @param readBytes Number of bytes read by this process.
+    * @param buffer Buffer in which the data is read.
+    * @return If true, this process read its data successfully.*/
+   bool ParallelReader::readFileBytes(const MPI_Offset& start,const uint64_t& readBytes,char* buffer) {
+      bool success = true;
 
       // If readBytes is larger than getMaxBytesPerRead() this process needs 
       // more than one collective call to read in all the data.
@@ -475,7 +623,6 @@ namespace vlsv {
 
       // Read data:
       const double t_start = MPI_Wtime();
-      size_t offset = 0;
       for (size_t counter=0; counter<globalExtraCollectiveReads; ++counter) {
          char*  pos;
          size_t readSize;
@@ -501,20 +648,75 @@ namespace vlsv {
          // Check that we got everything we requested:
          int bytesReceived;
          MPI_Get_count(&status,MPI_BYTE,&bytesReceived);
-         if (bytesReceived != readSize) {
+         if (bytesReceived != (int)readSize) {
             stringstream ss;
             ss << "ERROR in vlsv::ParallelReader! I only got " << bytesReceived << "/" << readSize;
             ss << " bytes in " << __FILE__ << ":" << __LINE__ << endl;
             cerr << ss.str();
             success = false;
          }
+      }
+      readTime  += (MPI_Wtime() - t_start);
+      bytesRead += readBytes;
+      return success;
+   }
 
-         offset += readSize;
+   /** Read bytes from a subfile or a referenced file. Each process opens the files 
+    * it needs independently when they are read for the first time, and reads them 
+    * with independent reads.
+    * @param name Name of the file.
+    * @param start File offset where the read starts.
+    * @param bytes Number of bytes read by this process.
+    * @param buffer Buffer in which the data is read.
+    * @return If true, this process read its data successfully.*/
+   bool ParallelReader::readExternalBytes(const std::string& name,const MPI_Offset& start,const uint64_t& bytes,char* buffer) {
+      map<string,MPI_File>::iterator it = externalFiles.find(name);
+      if (it == externalFiles.end()) {
+         MPI_File externalFile;
+         if (MPI_File_open(MPI_COMM_SELF,const_cast<char*>(name.c_str()),MPI_MODE_RDONLY,MPI_INFO_NULL,&externalFile) != MPI_SUCCESS) {
+            cerr << "ERROR in vlsv::ParallelReader! Failed to open file '" << name << "'" << endl;
+            return false;
+         }
+         it = externalFiles.insert(make_pair(name,externalFile)).first;
+      }
+
+      // Independent reads are split so that each read is at most getMaxBytesPerRead() bytes:
+      bool success = true;
+      const double t_start = MPI_Wtime();
+      for (uint64_t pos=0; pos<bytes; pos+=getMaxBytesPerRead()) {
+         const uint64_t readBytes = min(bytes-pos,static_cast<uint64_t>(getMaxBytesPerRead()));
+         MPI_Status status;
+         int bytesReceived = 0;
+         if (MPI_File_read_at(it->second,start+pos,buffer+pos,readBytes,MPI_BYTE,&status) != MPI_SUCCESS) success = false;
+         MPI_Get_count(&status,MPI_BYTE,&bytesReceived);
+         if (bytesReceived != (int)readBytes) success = false;
       }
       readTime  += (MPI_Wtime() - t_start);
-      bytesRead += amount*arrayOpen.vectorSize*arrayOpen.dataSize;
+      bytesRead += bytes;
+      return success;
+   }
 
-      return checkSuccess(success,comm);
+   /** Read a range of bytes of the currently open array that is stored in subfiles. 
+    * Array data is the concatenation of the segments in subfile order.
+    * @param start Byte offset relative to array start where the range starts.
+    * @param bytes Number of bytes read by this process.
+    * @param buffer Buffer in which the data is read.
+    * @return If true, this process read its data successfully.*/
+   bool ParallelReader::readSubfileBytes(const uint64_t& start,const uint64_t& bytes,char* buffer) {
+      bool success = true;
+      const uint64_t end = start + bytes;
+      uint64_t segmentStart = 0;
+      for (uint64_t s=0; s<arrayOpen.subfiles && segmentStart<end; ++s) {
+         const uint64_t segmentEnd = segmentStart + arrayOpen.subfileTable[2*s+1];
+         if (segmentEnd > start) {
+            const uint64_t readStart = max(start,segmentStart);
+            const uint64_t readEnd = min(end,segmentEnd);
+            if (readExternalBytes(getSubfileName(fileName,s),arrayOpen.subfileTable[2*s]+readStart-segmentStart,
+                                  readEnd-readStart,buffer+(readStart-start)) == false) success = false;
+         }
+         segmentStart = segmentEnd;
+      }
+      return success;
    }
 
    /** Start multi-read mode. In multi-read mode processes add zero or more file I/O units 
@@ -531,11 +733,122 @@ namespace vlsv {
       if (parallelFileOpen == false) return false;
       bool success = true;
       multiReadUnits.clear();
+      multiReadUnits.setMaxUnitBytes(getMaxBytesPerRead());
       if (getArrayInfo(tagName,attribs) == false) {
          return false;
       }
+      if (verifyOpenArrayChecksum() == false) return false;
       if (success == true) multireadStarted = true;
       return success;
    }
 
+   /** Verify the checksum of the given array. Processes read and checksum
+    * an equal share of the array, and the checksums are combined on master process.
+    * This function must be called by all processes.
+    * @param tagName Name of the XML tag of the array.
+    * @param attribs Attributes of the array.
+    * @return If true, array was found and either has no checksum or its checksum is correct.
+    * Return value is the same on all processes.*/
+   bool ParallelReader::verifyArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs) {
+      if (getArrayInfo(tagName,attribs) == false) return false;
+      if (arrayOpen.hasChecksum == false) return true;
+      return verifyFileChecksum(arrayOpen.offset,getStoredBytes(),arrayOpen.checksum);
+   }
+
+   /** Verify the checksums of all arrays in the file that have a checksum.
+    * This function must be called by all processes.
+    * @param arraysVerified Number of arrays whose checksums were verified.
+    * @param failedArrays Descriptions of arrays whose checksums did not match.
+    * @return If true, all checksums were correct. Return value is the same on all processes.*/
+   bool ParallelReader::verifyArrays(uint64_t& arraysVerified,std::vector<std::string>& failedArrays) {
+      arraysVerified = 0;
+      failedArrays.clear();
+      if (parallelFileOpen == false) return false;
+
+      // Master finds the arrays and broadcasts their descriptions, 
+      // separated by newlines, to all processes:
+      vector<string> names;
+      vector<uint64_t> checksums;
+      string nameList;
+      if (myRank == masterRank) {
+         getChecksummedArrays(names,checksums);
+         for (size_t a=0; a<names.size(); ++a) nameList += names[a] + '\n';
+      }
+      uint64_t sizes[2];
+      sizes[0] = checksums.size();
+      sizes[1] = nameList.size();
+      MPI_Bcast(sizes,2,MPI_Type<uint64_t>(),masterRank,comm);
+      checksums.resize(sizes[0]);
+      nameList.resize(sizes[1]);
+      if (sizes[0] > 0) MPI_Bcast(&(checksums[0]),sizes[0],MPI_Type<uint64_t>(),masterRank,comm);
+      if (sizes[1] > 0) MPI_Bcast(&(nameList[0]),sizes[1],MPI_Type<char>(),masterRank,comm);
+
+      size_t position = 0;
+      for (size_t a=0; a<checksums.size()/3; ++a) {
+         const size_t end = nameList.find('\n',position);
+         const string name = nameList.substr(position,end-position);
+         position = end+1;
+         if (verifyFileChecksum(checksums[3*a+0],checksums[3*a+1],checksums[3*a+2]) == false) failedArrays.push_back(name);
+         ++arraysVerified;
+      }
+      return failedArrays.size() == 0;
+   }
+
+   /** Compute the checksum of a region of the file in parallel and compare it to 
+    * the given checksum. The region is divided evenly between processes, and it is 
+    * read in blocks to limit memory use. This function must be called by all processes.
+    * @param offset File offset of the region.
+    * @param bytes Number of bytes in the region.
+    * @param checksum Expected checksum.
+    * @return If true, the checksums match. Return value is the same on all processes.*/
+   bool ParallelReader::verifyFileChecksum(const uint64_t& offset,const uint64_t& bytes,const uint32_t& checksum) {
+      bool success = true;
+      const uint64_t bytesPerProcess = (bytes + processes - 1) / processes;
+      const uint64_t myStart = min(bytes,myRank*bytesPerProcess);
+      const uint64_t myBytes = min(bytes,myStart+bytesPerProcess) - myStart;
+
+      // Every process makes the same number of collective reads:
+      const uint64_t blockBytes = min(bytesPerProcess,static_cast<uint64_t>(64*1024*1024));
+      const uint64_t N_blocks = (blockBytes == 0) ? 0 : (bytesPerProcess + blockBytes - 1) / blockBytes;
+      if (stagingBuffer.size() < blockBytes+1) stagingBuffer.resize(blockBytes+1);
+
+      uint64_t myChecksum[2];
+      myChecksum[0] = 0;
+      myChecksum[1] = myBytes;
+      for (uint64_t b=0; b<N_blocks; ++b) {
+         const uint64_t blockStart = min(myBytes,b*blockBytes);
+         const uint64_t readBytes = min(myBytes,blockStart+blockBytes) - blockStart;
+         if (readFileBytes(offset+myStart+blockStart,readBytes,&(stagingBuffer[0])) == false) success = false;
+         myChecksum[0] = crc32c(myChecksum[0],&(stagingBuffer[0]),readBytes);
+      }
+
+      // Master combines the checksums and checks the result:
+      uint64_t fileChecksum[2];
+      if (reduceChecksums(myChecksum,1,fileChecksum,masterRank,comm) == false) success = false;
+      if (myRank == masterRank) {
+         if (fileChecksum[0] != checksum) success = false;
+      }
+      uint8_t masterSuccess = success;
+      MPI_Bcast(&masterSuccess,1,MPI_Type<uint8_t>(),masterRank,comm);
+      return checkSuccess(success && masterSuccess > 0,comm);
+   }
+
+   /** Verify the checksum of the currently open array, if checksum verification is
+    * enabled and the array has a checksum. Each array is verified only once.
+    * This function must be called by all processes.
+    * @return If false, checksum of the array did not match the stored data.*/
+   bool ParallelReader::verifyOpenArrayChecksum() {
+      if (verifyChecksums == false || arrayOpen.hasChecksum == false) return true;
+      if (verifiedArrays.find(arrayOpen.offset) != verifiedArrays.end()) return true;
+      if (verifyFileChecksum(arrayOpen.offset,getStoredBytes(),arrayOpen.checksum) == false) {
+         if (myRank == masterRank) {
+            cerr << "ERROR in vlsv::ParallelReader! Checksum mismatch in array '" << arrayOpen.tagName;
+            cerr << "' at offset " << arrayOpen.offset << endl;
+         }
+         return false;
+      }
+      verifiedArrays.insert(arrayOpen.offset);
+      return true;
+   }
+
 } // namespace vlsv
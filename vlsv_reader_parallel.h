@@ -20,6 +20,8 @@
 #define VLSV_READER_PARALLEL_H
 
 #include <mpi.h>
+#include <map>
+#include <vector>
 
 #include "vlsv_reader.h"
 #include "mpiconversion.h"
@@ -47,6 +49,10 @@ namespace vlsv {
                            const uint64_t& begin,const uint64_t& amount,char* buffer);
       bool readArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs,
                      const uint64_t& begin,const uint64_t& amount,char* buffer);
+      void setHintCache(const std::string& fileName);
+      void setIOStrategy(const iostrategy::type& strategy);
+      bool verifyArray(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs);
+      bool verifyArrays(uint64_t& arraysVerified,std::vector<std::string>& failedArrays);
 
       bool addMultireadUnit(char* buffer,const uint64_t& amount);
       bool endMultiread(const uint64_t& arrayOffset);
@@ -59,20 +65,32 @@ namespace vlsv {
       bool readParameter(const std::string& parameterName,T& value);
 
     private:
+      std::vector<int> blockLengths;  /**< Used in creation of an MPI datatype in flushMultiread, reused across flushes.*/
       uint64_t bytesRead;             /**< Number of bytes read by this process.*/
       MPI_Comm comm;                  /**< MPI communicator used to read the file.*/
+      std::vector<MPI_Datatype> datatypes; /**< Used in creation of an MPI datatype in flushMultiread, reused across flushes.*/
+      std::vector<MPI_Aint> displacements; /**< Used in creation of an MPI datatype in flushMultiread, reused across flushes.*/
+      std::map<std::string,MPI_File> externalFiles; /**< Subfiles and referenced files opened by this process, indexed by name.*/
       MPI_File filePtr;               /**< MPI file pointer to input file.*/
+      std::string hintCache;          /**< Name of the hint cache file, empty if not used, see setHintCache.*/
+      iostrategy::type ioStrategy;    /**< Method used to transfer multi-read units to MPI, see selectIOStrategy.*/
       int masterRank;                 /**< MPI rank of master process.*/
+      Multi_IO_Buffer multiReadUnits; /**< Multi-read units of this process.*/
       bool multireadStarted;          /**< If true, multiread mode has been initialized successfully.*/
       int myRank;                     /**< MPI rank of this process in communicator comm.*/
       bool parallelFileOpen;          /**< If true, all processes have opened input file successfully.*/
       int processes;                  /**< Number of MPI processes in communicator comm.*/
       double readTime;                /**< Time spent in seconds to read bytesRead bytes by this process.*/
-
-      std::list<Multi_IO_Unit> multiReadUnits;
+      std::vector<char> stagingBuffer; /**< Buffer in which fragmented multi-read units are read, reused across flushes.*/
 
       bool getArrayInfo(const std::string& tagName,const std::list<std::pair<std::string,std::string> >& attribs);
-      bool flushMultiread(const size_t& unit,const MPI_Offset& currentOffset,std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop);
+      bool flushMultiread(const size_t& unit,const MPI_Offset& currentOffset,Multi_IO_Buffer::iterator& start,Multi_IO_Buffer::iterator& stop);
+      bool readChunks(const uint64_t& begin,const uint64_t& amount,char* buffer);
+      bool readFileBytes(const MPI_Offset& start,const uint64_t& bytes,char* buffer);
+      bool readExternalBytes(const std::string& name,const MPI_Offset& start,const uint64_t& bytes,char* buffer);
+      bool readSubfileBytes(const uint64_t& start,const uint64_t& bytes,char* buffer);
+      bool verifyFileChecksum(const uint64_t& offset,const uint64_t& bytes,const uint32_t& checksum);
+      bool verifyOpenArrayChecksum();
    };
 
    template<typename T>
@@ -86,23 +104,22 @@ namespace vlsv {
       // Check that requested read is inside the array:
       if (begin > arrayOpen.arraySize || (begin+amount) > arrayOpen.arraySize) return false;
 
-      char* buffer = new char[amount*arrayOpen.vectorSize*arrayOpen.dataSize];
-      if (ParallelReader::readArray(tagName,attribs,begin,amount,buffer) == false) {
-         delete [] buffer; buffer = NULL;
-         return false;
-      }
-
-      // Copy data from temporary buffer to output array:
-      if (allocateMemory == true) outBuffer = new T[amount*arrayOpen.vectorSize];
-      char* ptr = buffer;
-      for (uint64_t i=0; i<amount; ++i) {
-         for (uint64_t j=0; j<arrayOpen.vectorSize; ++j) {
-            convertValue<T>(outBuffer[i*arrayOpen.vectorSize+j],ptr,arrayOpen.dataType,arrayOpen.dataSize,false);
-            ptr += arrayOpen.dataSize;
-         }
-      }
-      delete [] buffer; buffer = NULL;
-      return true;
+      // If the stored datatype is not larger than T, data is read into the end of output 
+      // buffer and converted in place, see Reader::read. Otherwise data is read into a temporary buffer:
+      const uint64_t N_values = amount*arrayOpen.vectorSize;
+      const uint64_t dataSize = arrayOpen.dataSize;
+      const datatype::type dataType = arrayOpen.dataType;
+      const bool inPlace = (dataType == datatype::UNKNOWN) ? (dataSize == sizeof(T)) : (dataSize <= sizeof(T));
+      if (allocateMemory == true) outBuffer = new T[N_values];
+      char* buffer = NULL;
+      if (inPlace == true) buffer = reinterpret_cast<char*>(outBuffer) + N_values*(sizeof(T)-dataSize);
+      else buffer = new char[N_values*dataSize];
+
+      bool success = ParallelReader::readArray(tagName,attribs,begin,amount,buffer);
+      if (success == true) success = convertArray<T>(outBuffer,buffer,dataType,dataSize,N_values);
+      if (inPlace == false) {delete [] buffer; buffer = NULL;}
+      if (success == false && allocateMemory == true) {delete [] outBuffer; outBuffer = NULL;}
+      return success;
    }
 
    template<typename T> inline
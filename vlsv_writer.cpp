@@ -16,34 +16,368 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
 
 #include "mpiconversion.h"
 #include "vlsv_common_mpi.h"
+#include "vlsv_checksum.h"
+#include "vlsv_compression.h"
+#include "vlsv_hints.h"
 #include "vlsv_writer.h"
 
 using namespace std;
 
 namespace vlsv {
 
+   /** State of a footer write in Writer::writeFooter.*/
+   struct FooterWrite {
+      bool dryRunning;   /**< If true, nothing is written to the file.*/
+      MPI_File fileptr;  /**< Output file.*/
+      MPI_Offset offset; /**< Offset into output file where the next chunk is written.*/
+   };
+
+   /** Write a chunk of serialized footer to output file, see muxml::MuXML::serialize.
+    * A short write, e.g. due to a full file system, is a failure.
+    * @param data Serialized footer.
+    * @param bytes Number of bytes in data.
+    * @param userData Pointer to FooterWrite.
+    * @return If true, the chunk was written successfully.*/
+   static bool writeFooterChunk(const char* data,const size_t& bytes,void* userData) {
+      FooterWrite* footer = reinterpret_cast<FooterWrite*>(userData);
+      if (footer->dryRunning == false) {
+         MPI_Status status;
+         int count = 0;
+         if (MPI_File_write_at(footer->fileptr,footer->offset,const_cast<char*>(data),bytes,MPI_BYTE,&status) != MPI_SUCCESS) return false;
+         if (MPI_Get_count(&status,MPI_BYTE,&count) != MPI_SUCCESS || static_cast<size_t>(count) != bytes) return false;
+      }
+      footer->offset += bytes;
+      return true;
+   }
+
+   /** Get the identifier of a string in the string table of the binary footer index, 
+    * see footerindex. A string that is not in the table yet is appended to it.
+    * @param value The string.
+    * @param strings String table.
+    * @param stringIds Identifiers of the strings in the string table.
+    * @return Position of the string in the string table.*/
+   static uint64_t getFooterIndexString(const string& value,string& strings,unordered_map<string,uint64_t>& stringIds) {
+      unordered_map<string,uint64_t>::const_iterator it = stringIds.find(value);
+      if (it != stringIds.end()) return it->second;
+      const uint64_t id = strings.size();
+      strings.append(value.c_str(),value.size()+1);
+      stringIds.insert(make_pair(value,id));
+      return id;
+   }
+
+   /** Maximum number of vector components for which statistics are stored in 
+    * the footer. Statistics of all components are stored in a single attribute 
+    * value, and the length of attribute values is limited.*/
+   static const uint64_t MAX_STATISTICS_COMPONENTS = 16;
+
+   /** Accumulate statistics of each vector component of the given data, ignoring NaN values.
+    * @param data Data vectors.
+    * @param N_vectors Number of data vectors.
+    * @param vectorSize Number of components in each data vector.
+    * @param stats Array of [min,max,sum,count] tuples, one per vector component.*/
+   template<typename T>
+   static void accumulateStatistics(const T* data,const uint64_t& N_vectors,const uint64_t& vectorSize,double* stats) {
+      for (uint64_t c=0; c<vectorSize; ++c) {
+         double minValue = stats[4*c+0];
+         double maxValue = stats[4*c+1];
+         double sum = stats[4*c+2];
+         double count = stats[4*c+3];
+         #ifdef _OPENMP
+            #pragma omp simd reduction(min:minValue) reduction(max:maxValue) reduction(+:sum,count)
+         #endif
+         for (uint64_t i=0; i<N_vectors; ++i) {
+            const double value = data[i*vectorSize+c];
+            const bool valid = (value == value);
+            minValue = (value < minValue) ? value : minValue;
+            maxValue = (value > maxValue) ? value : maxValue;
+            sum += valid ? value : 0.0;
+            count += valid ? 1.0 : 0.0;
+         }
+         stats[4*c+0] = minValue;
+         stats[4*c+1] = maxValue;
+         stats[4*c+2] = sum;
+         stats[4*c+3] = count;
+      }
+   }
+
+   /** Calculate statistics of each vector component of data in multi-I/O units. 
+    * Each unit must contain whole data vectors.
+    * @param units Multi-I/O units.
+    * @param vlsvType Datatype of the data.
+    * @param dataSize Byte size of the datatype.
+    * @param vectorSize Number of components in each data vector.
+    * @param stats Array in which [min,max,sum,count] tuples of each vector component are written.
+    * @return If false, statistics are not supported for the datatype.*/
+   static bool unitStatistics(const Multi_IO_Buffer& units,const datatype::type& vlsvType,const uint64_t& dataSize,
+                              const uint64_t& vectorSize,double* stats) {
+      for (uint64_t c=0; c<vectorSize; ++c) {
+         stats[4*c+0] = numeric_limits<double>::infinity();
+         stats[4*c+1] = -numeric_limits<double>::infinity();
+         stats[4*c+2] = 0.0;
+         stats[4*c+3] = 0.0;
+      }
+
+      MPI_Datatype previousType = MPI_DATATYPE_NULL;
+      int datatypeBytesize = 0;
+      for (Multi_IO_Buffer::const_iterator it=units.begin(); it!=units.end(); ++it) {
+         if (it->mpiType != previousType) {
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            previousType = it->mpiType;
+         }
+         const uint64_t N_vectors = it->amount*datatypeBytesize/dataSize/vectorSize;
+         switch (vlsvType) {
+          case datatype::FLOAT:
+            if (dataSize == sizeof(float)) accumulateStatistics(reinterpret_cast<const float*>(it->array),N_vectors,vectorSize,stats);
+            else if (dataSize == sizeof(double)) accumulateStatistics(reinterpret_cast<const double*>(it->array),N_vectors,vectorSize,stats);
+            else return false;
+            break;
+          case datatype::INT:
+            if (dataSize == sizeof(int8_t)) accumulateStatistics(reinterpret_cast<const int8_t*>(it->array),N_vectors,vectorSize,stats);
+            else if (dataSize == sizeof(int16_t)) accumulateStatistics(reinterpret_cast<const int16_t*>(it->array),N_vectors,vectorSize,stats);
+            else if (dataSize == sizeof(int32_t)) accumulateStatistics(reinterpret_cast<const int32_t*>(it->array),N_vectors,vectorSize,stats);
+            else if (dataSize == sizeof(int64_t)) accumulateStatistics(reinterpret_cast<const int64_t*>(it->array),N_vectors,vectorSize,stats);
+            else return false;
+            break;
+          case datatype::UINT:
+            if (dataSize == sizeof(uint8_t)) accumulateStatistics(reinterpret_cast<const uint8_t*>(it->array),N_vectors,vectorSize,stats);
+            else if (dataSize == sizeof(uint16_t)) accumulateStatistics(reinterpret_cast<const uint16_t*>(it->array),N_vectors,vectorSize,stats);
+            else if (dataSize == sizeof(uint32_t)) accumulateStatistics(reinterpret_cast<const uint32_t*>(it->array),N_vectors,vectorSize,stats);
+            else if (dataSize == sizeof(uint64_t)) accumulateStatistics(reinterpret_cast<const uint64_t*>(it->array),N_vectors,vectorSize,stats);
+            else return false;
+            break;
+          default:
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /** Check if statistics can be calculated for arrays of the given type.
+    * @param vlsvType Datatype of the array.
+    * @param dataSize Byte size of the datatype.
+    * @param vectorSize Number of components in each data vector.
+    * @return If true, statistics are supported.*/
+   static bool statisticsSupported(const datatype::type& vlsvType,const uint64_t& dataSize,const uint64_t& vectorSize) {
+      if (vectorSize == 0 || vectorSize > MAX_STATISTICS_COMPONENTS) return false;
+      if (vlsvType == datatype::FLOAT) return dataSize == sizeof(float) || dataSize == sizeof(double);
+      if (vlsvType == datatype::INT || vlsvType == datatype::UINT) {
+         return dataSize == 1 || dataSize == 2 || dataSize == 4 || dataSize == 8;
+      }
+      return false;
+   }
+
+   /** Calculate the CRC32C checksum of data in multi-I/O units.
+    * @param units Multi-I/O units.
+    * @param checksum Array in which the checksum and the number of bytes in units are written.*/
+   static void unitChecksum(const Multi_IO_Buffer& units,uint64_t* checksum) {
+      uint32_t crc = 0;
+      uint64_t bytes = 0;
+      MPI_Datatype previousType = MPI_DATATYPE_NULL;
+      int datatypeBytesize = 0;
+      for (Multi_IO_Buffer::const_iterator it=units.begin(); it!=units.end(); ++it) {
+         if (it->mpiType != previousType) {
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            previousType = it->mpiType;
+         }
+         crc = crc32c(crc,it->array,it->amount*datatypeBytesize);
+         bytes += it->amount*datatypeBytesize;
+      }
+      checksum[0] = crc;
+      checksum[1] = bytes;
+   }
+
+   /** Calculate a hash of data in multi-I/O units, see hash64. The hash does not 
+    * depend on how the data is split into units.
+    * @param units Multi-I/O units.
+    * @return Hash of the data.*/
+   static uint64_t unitHash(const Multi_IO_Buffer& units) {
+      Hash64 hash;
+      MPI_Datatype previousType = MPI_DATATYPE_NULL;
+      int datatypeBytesize = 0;
+      for (Multi_IO_Buffer::const_iterator it=units.begin(); it!=units.end(); ++it) {
+         if (it->mpiType != previousType) {
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            previousType = it->mpiType;
+         }
+         hash64(hash,it->array,it->amount*datatypeBytesize);
+      }
+      return hash64Final(hash);
+   }
+
+   /** Get the key by which an array is identified in WriteHistory.
+    * @param tagName Name of the XML tag of the array.
+    * @param attribs Attributes of the XML tag.
+    * @return Key of the array.*/
+   static string getHistoryKey(const std::string& tagName,const std::map<std::string,std::string>& attribs) {
+      stringstream ss;
+      ss << tagName;
+      for (map<string,string>::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
+         ss << '\0' << it->first << '=' << it->second;
+      }
+      return ss.str();
+   }
+
+   /** Get the striping unit of the output file. The value reported by MPI for the open 
+    * file is used, then the hint given by the user. If neither is known, 1 MiB is returned.
+    * @param fileptr Output file, ignored if it is MPI_FILE_NULL.
+    * @param userInfo MPI info given to Writer::open, may be MPI_INFO_NULL.
+    * @return Striping unit in bytes.*/
+   static uint64_t getStripingUnit(MPI_File fileptr,MPI_Info userInfo) {
+      uint64_t stripingUnit = 0;
+      char value[MPI_MAX_INFO_VAL];
+      int flag = 0;
+      if (fileptr != MPI_FILE_NULL) {
+         MPI_Info fileInfo;
+         if (MPI_File_get_info(fileptr,&fileInfo) == MPI_SUCCESS) {
+            MPI_Info_get(fileInfo,const_cast<char*>("striping_unit"),MPI_MAX_INFO_VAL-1,value,&flag);
+            if (flag != 0) stripingUnit = atol(value);
+            MPI_Info_free(&fileInfo);
+         }
+      }
+      if (stripingUnit == 0 && userInfo != MPI_INFO_NULL) {
+         MPI_Info_get(userInfo,const_cast<char*>("striping_unit"),MPI_MAX_INFO_VAL-1,value,&flag);
+         if (flag != 0) stripingUnit = atol(value);
+      }
+      if (stripingUnit == 0) stripingUnit = 1024*1024;
+      return stripingUnit;
+   }
+
+   /** Create MPI info object with Lustre striping hints suitable for a file of the 
+    * given size. Hints given by the user are not overridden. Striping hints only 
+    * have an effect when the file is created, and are ignored by file systems that 
+    * do not support them.
+    * @param userInfo MPI info given to Writer::open, may be MPI_INFO_NULL.
+    * @param fileSize Expected size of the file in bytes.
+    * @param N_processes Number of processes writing the file.
+    * @param info Variable in which the created info object is written, must be freed by the caller.*/
+   static void createStripingInfo(MPI_Info userInfo,const uint64_t& fileSize,const int& N_processes,MPI_Info& info) {
+      if (userInfo == MPI_INFO_NULL) MPI_Info_create(&info);
+      else MPI_Info_dup(userInfo,&info);
+
+      // Large files use larger stripes. Each stripe should receive at least 
+      // 64 stripe units of data, and there is no point in having more stripes 
+      // than processes writing the file:
+      const uint64_t MiB = 1024*1024;
+      const uint64_t stripeUnit = (fileSize < 1024*MiB) ? MiB : 4*MiB;
+      uint64_t stripes = fileSize / (64*stripeUnit);
+      stripes = max(static_cast<uint64_t>(1),min(stripes,static_cast<uint64_t>(N_processes)));
+
+      const char* keys[2] = {"striping_unit","striping_factor"};
+      const uint64_t values[2] = {stripeUnit,stripes};
+      for (int i=0; i<2; ++i) {
+         char value[MPI_MAX_INFO_VAL];
+         int flag = 0;
+         MPI_Info_get(info,const_cast<char*>(keys[i]),MPI_MAX_INFO_VAL-1,value,&flag);
+         if (flag != 0) continue;
+         stringstream ss;
+         ss << values[i];
+         MPI_Info_set(info,const_cast<char*>(keys[i]),const_cast<char*>(ss.str().c_str()));
+      }
+   }
+
+   /** Constructor for WriteLayout. The layout is empty until Writer records it.*/
+   WriteLayout::WriteLayout(): fileSize(0),reused(false) { }
+
+   /** Forget the recorded layout.*/
+   void WriteLayout::clear() {
+      arrayOffsets.clear();
+      fileSize = 0;
+      reused = false;
+   }
+
+   /** Get the file offsets of arrays in the order they were written.
+    * @return File offsets.*/
+   const std::vector<uint64_t>& WriteLayout::getArrayOffsets() const {return arrayOffsets;}
+
+   /** Get the recorded file size.
+    * @return Size of the file in bytes, zero if no layout has been recorded.*/
+   uint64_t WriteLayout::getFileSize() const {return fileSize;}
+
+   /** Check if the most recently written file had the same layout as the file 
+    * before it, i.e., if the file was preallocated to exactly the right size.
+    * @return If true, the layout was reused.*/
+   bool WriteLayout::wasReused() const {return reused;}
+
+   const uint64_t Writer::STRIPE_ALIGNMENT;
+
+   /** Constructor for WriteHistory. The history is empty until Writer records arrays in it.*/
+   WriteHistory::WriteHistory(): referencedArrays(0),referencedBytes(0) { }
+
+   /** Forget all recorded arrays. The next file will contain the data of all arrays.*/
+   void WriteHistory::clear() {
+      arrays.clear();
+      referencedArrays = 0;
+      referencedBytes = 0;
+   }
+
+   /** Get the number of arrays stored as references in the most recently written file.
+    * @return Number of referenced arrays.*/
+   uint64_t WriteHistory::getReferencedArrays() const {return referencedArrays;}
+
+   /** Get the number of array bytes that were not written to the most recently 
+    * written file because the arrays were stored as references.
+    * @return Number of bytes.*/
+   uint64_t WriteHistory::getReferencedBytes() const {return referencedBytes;}
+
    /** Constructor for Writer.*/
    Writer::Writer() {
-      blockLengths = NULL;
-      bytesPerProcess = NULL;
-      displacements = NULL;
+      aggregationComm = MPI_COMM_NULL;
+      aggregatorsPerNode = 0;
+      alignment = 0;
+      alignmentRequest = 0;
+      arrayChecksum = 0;
+      arraysSinceSnapshot = 0;
+      asyncRequestCounter = 0;
+      asyncWrite = false;
+      batchFailed = false;
+      batchMode = false;
+      checksums = false;
+      statistics = false;
+      compressionChunkBytes = 1048576;
+      compressionMethod = compression::NONE;
       dryRunning = false;
       endMultiwriteCounter = 0;
       fileOpen = false;
+      footerIndex = true;
+      footerInterval = 0;
+      hintInfo = MPI_INFO_NULL;
+      history = NULL;
       initialized = false;
+      ioStrategy = iostrategy::AUTO;
+      layout = NULL;
+      mantissaBits = -1;
+      multiwriteFailed = false;
       multiwriteFinalized = false;
       multiwriteInitialized = false;
       multiwriteOffsetPointer = NULL;
+      myChunkOffset = 0;
+      myOffset = 0;
       N_multiwriteUnits = 0;
       offset = 0;
-      offsets = NULL;
-      types = NULL;
+      preallocate = false;
+      preallocatedBytes = 0;
+      referenceOffset = 0;
+      snapshotOffset = 0;
+      storeAsFloat = false;
+      subfileArray = false;
+      subfileComm = MPI_COMM_NULL;
+      subfileIndex = 0;
+      subfileOffset = 0;
+      subfiles = 0;
+      totalArrayBytes = 0;
+      totalBytes = 0;
+      totalChunks = 0;
       xmlWriter = NULL;
       comm = MPI_COMM_NULL;
    }
@@ -52,17 +386,18 @@ namespace vlsv {
    Writer::~Writer() {
       if (fileOpen == true) close();
       if (comm != MPI_COMM_NULL) MPI_Comm_free(&comm);
-      delete [] blockLengths; blockLengths = NULL;
-      delete [] bytesPerProcess; bytesPerProcess = NULL;
-      delete [] displacements; displacements = NULL;
-      delete [] offsets; offsets = NULL;
-      delete [] types; types = NULL;
+      if (aggregationComm != MPI_COMM_NULL) MPI_Comm_free(&aggregationComm);
+      if (subfileComm != MPI_COMM_NULL) MPI_Comm_free(&subfileComm);
+      if (hintInfo != MPI_INFO_NULL) MPI_Info_free(&hintInfo);
       delete xmlWriter; xmlWriter = NULL;
    }
 
    /** Add a multi-write unit. Function startMultiwrite must have been called 
     * by all processes prior to calling addMultiwriteUnit. The process must 
-    * call endMultiwrite after it has added all multi-write units.
+    * call endMultiwrite after it has added all multi-write units. If VLSV is 
+    * compiled with OpenMP, threads of a parallel region may call this function 
+    * concurrently. Each thread stores its units separately, and the data of 
+    * thread t is written after the data of threads 0,...,t-1.
     * @param array Pointer to the start of data.
     * @param arrayElements Number of array elements in this multi-write unit.
     * @return If true, the multi-write unit was added successfully.
@@ -74,6 +409,8 @@ namespace vlsv {
       // it is safe to exit immediately here if error(s) have occurred:
       if (initialized == false) return false;
       if (multiwriteInitialized == false) return false;
+      Multi_IO_Buffer* units = getThreadUnits();
+      if (units == NULL) return false;
 
       // Do not add zero-size arrays to multiWriteUnits:
       if (arrayElements == 0) return true;
@@ -99,10 +436,339 @@ namespace vlsv {
             if ((i+1)*maxElementsPerWrite >= arrayElements) elements = arrayElements - i*maxElementsPerWrite;
 
             const size_t byteOffset = maxElementsPerWrite*vectorSize*datatypeBytesize;
-            multiwriteUnits[0].push_back(Multi_IO_Unit(array+i*byteOffset,getMPIDatatype(vlsvType,dataSize),elements*vectorSize));
+            units->push_back(Multi_IO_Unit(array+i*byteOffset,getMPIDatatype(vlsvType,dataSize),elements*vectorSize));
          }
       } else {
-         multiwriteUnits[0].push_back(Multi_IO_Unit(array,getMPIDatatype(vlsvType,dataSize),arrayElements*vectorSize));
+         units->push_back(Multi_IO_Unit(array,getMPIDatatype(vlsvType,dataSize),arrayElements*vectorSize));
+      }
+      return true;
+   }
+
+   /** Write multi-write units to file using node-level aggregation. Processes in 
+    * communicator aggregationComm pack their data and send it to an aggregator 
+    * process, who then writes the data of all processes with a single 
+    * contiguous (or nearly contiguous) write. If the aggregated data would exceed 
+    * the maximum number of bytes that can be written with a single collective call, 
+    * each process writes its own data instead. All processes in communicator comm 
+    * must call this function.
+    * @param fileOffset Offset into output file where this process' data is written.
+    * @param start Iterator pointing to the first written multi-write unit.
+    * @param stop Iterator pointing past the last written multi-write unit.
+    * @param bytes Total number of bytes in the written multi-write units.
+    * @return If true, this process succeeded in writing out the data.*/
+   bool Writer::aggregatedWrite(const MPI_Offset& fileOffset,Multi_IO_Buffer::iterator& start,
+                                Multi_IO_Buffer::iterator& stop,const uint64_t& bytes) {
+      bool success = true;
+      int groupRank,groupSize;
+      MPI_Comm_rank(aggregationComm,&groupRank);
+      MPI_Comm_size(aggregationComm,&groupSize);
+
+      // Exchange file offsets and byte counts within the aggregation group:
+      uint64_t mySegment[2];
+      mySegment[0] = fileOffset;
+      mySegment[1] = bytes;
+      vector<uint64_t> segments(2*groupSize);
+      MPI_Allgather(mySegment,2,MPI_Type<uint64_t>(),&(segments[0]),2,MPI_Type<uint64_t>(),aggregationComm);
+
+      uint64_t groupBytes = 0;
+      for (int i=0; i<groupSize; ++i) groupBytes += segments[2*i+1];
+      const bool aggregate = (groupBytes <= getMaxBytesPerWrite());
+
+      // Pack multi-write units into a contiguous buffer. Aggregator reserves 
+      // space for the data of all processes in the group:
+      uint64_t bufferSize = bytes;
+      if (aggregate == true && groupRank == 0) bufferSize = groupBytes;
+      if (aggregationBuffer.size() < bufferSize) aggregationBuffer.resize(bufferSize);
+      char* packBuffer = NULL;
+      if (bufferSize > 0) packBuffer = &(aggregationBuffer[0]);
+
+      packUnits(start,stop,packBuffer);
+
+      // List file segments written by this process, adjacent segments are merged:
+      vector<int> blockLengths;
+      vector<MPI_Aint> displacements;
+      uint64_t writeBytes = 0;
+      if (aggregate == true) {
+         if (groupRank == 0) {
+            vector<int> recvCounts(groupSize);
+            vector<int> recvDispls(groupSize);
+            for (int i=0; i<groupSize; ++i) {
+               recvCounts[i] = segments[2*i+1];
+               recvDispls[i] = writeBytes;
+               writeBytes += segments[2*i+1];
+               if (segments[2*i+1] == 0) continue;
+               if (displacements.size() > 0 && displacements.back()+blockLengths.back() == (MPI_Aint)segments[2*i]) {
+                  blockLengths.back() += segments[2*i+1];
+               } else {
+                  displacements.push_back(segments[2*i]);
+                  blockLengths.push_back(segments[2*i+1]);
+               }
+            }
+            MPI_Gatherv(MPI_IN_PLACE,0,MPI_BYTE,packBuffer,&(recvCounts[0]),&(recvDispls[0]),MPI_BYTE,0,aggregationComm);
+         } else {
+            MPI_Gatherv(packBuffer,bytes,MPI_BYTE,NULL,NULL,NULL,MPI_BYTE,0,aggregationComm);
+         }
+      } else if (bytes > 0) {
+         displacements.push_back(fileOffset);
+         blockLengths.push_back(bytes);
+         writeBytes = bytes;
+      }
+
+      // Set a file view that covers the written segments, write data, and restore the default view:
+      MPI_Datatype fileType = MPI_BYTE;
+      if (displacements.size() > 0) {
+         MPI_Type_create_hindexed(displacements.size(),&(blockLengths[0]),&(displacements[0]),MPI_BYTE,&fileType);
+         MPI_Type_commit(&fileType);
+      }
+
+      const double t_start = MPI_Wtime();
+      MPI_File dataFile = getDataFile();
+      MPI_File_set_view(dataFile,0,MPI_BYTE,fileType,const_cast<char*>("native"),MPI_INFO_NULL);
+      if (MPI_File_write_at_all(dataFile,0,packBuffer,writeBytes,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+      MPI_File_set_view(dataFile,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),MPI_INFO_NULL);
+      writeTime += (MPI_Wtime() - t_start);
+
+      if (fileType != MPI_BYTE) MPI_Type_free(&fileType);
+      return success;
+   }
+
+   /** Start queueing arrays for a batched write. After this function has been 
+    * called, writeArray and startMultiwrite/addMultiwriteUnit/endMultiwrite 
+    * calls do not write anything to the output file, nor call any MPI collectives. 
+    * Instead the arrays are queued and written with a single collective call 
+    * in commitBatch. The memory given to these functions must remain valid 
+    * until commitBatch has been called. All processes must queue the same 
+    * arrays in the same order.
+    * @return If true, batch mode was started successfully.
+    * @see commitBatch.*/
+   bool Writer::beginBatch() {
+      if (fileOpen == false) return false;
+      if (batchMode == true) return false;
+      batchMode = true;
+      batchFailed = false;
+      batchArrays.clear();
+      return true;
+   }
+
+   /** Write all arrays queued after beginBatch to the output file. File offsets 
+    * of all queued arrays are calculated with one prefix sum and one reduction, 
+    * and the data is written with a single collective call (unless a process 
+    * writes more than getMaxBytesPerWrite() bytes) using a file view that 
+    * covers this process' part of every queued array. The footer 
+    * is updated for all queued arrays. This function must be called 
+    * by all processes.
+    * @return If true, all queued arrays were written successfully.
+    * @see beginBatch.*/
+   bool Writer::commitBatch() {
+      bool success = true;
+      if (batchMode == false) success = false;
+      if (batchFailed == true) success = false;
+      batchMode = false;
+      const size_t N_arrays = batchArrays.size();
+
+      // Calculate this process' offset into every array and total array sizes. 
+      // First element in the reduction is the error count:
+      vector<uint64_t> myBytesPerArray(N_arrays+1);
+      vector<uint64_t> myOffsets(N_arrays+1);
+      vector<uint64_t> totals(N_arrays+1);
+      myBytesPerArray[0] = 0;
+      if (success == false) myBytesPerArray[0] = 1;
+      for (size_t a=0; a<N_arrays; ++a) myBytesPerArray[a+1] = batchArrays[a].myBytes;
+
+      MPI_Exscan(&(myBytesPerArray[0]),&(myOffsets[0]),N_arrays+1,MPI_Type<uint64_t>(),MPI_SUM,comm);
+      if (myrank == 0) for (size_t a=0; a<N_arrays+1; ++a) myOffsets[a] = 0;
+      MPI_Allreduce(&(myBytesPerArray[0]),&(totals[0]),N_arrays+1,MPI_Type<uint64_t>(),MPI_SUM,comm);
+      if (totals[0] > 0) {
+         batchArrays.clear();
+         return false;
+      }
+
+      // Split this process' data into rounds so that a single 
+      // collective call writes at most getMaxBytesPerWrite() bytes:
+      vector<size_t> roundStart(1,0);
+      vector<vector<int> > blockLengths(1);
+      vector<vector<MPI_Aint> > addresses(1);
+      vector<vector<MPI_Datatype> > types(1);
+      vector<vector<int> > fileLengths(1);
+      vector<vector<MPI_Aint> > fileOffsets(1);
+      uint64_t roundBytes = 0;
+      MPI_Offset arrayOffset = offset;
+      for (size_t a=0; a<N_arrays; ++a) {
+         arrayOffset = alignOffset(arrayOffset);
+         MPI_Offset fileOffset = arrayOffset + myOffsets[a+1];
+         for (Multi_IO_Buffer::iterator it=batchArrays[a].units.begin(); it!=batchArrays[a].units.end(); ++it) {
+            int datatypeBytesize;
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            const uint64_t unitBytes = it->amount*datatypeBytesize;
+            if (roundBytes > 0 && roundBytes + unitBytes > getMaxBytesPerWrite()) {
+               blockLengths.push_back(vector<int>());
+               addresses.push_back(vector<MPI_Aint>());
+               types.push_back(vector<MPI_Datatype>());
+               fileLengths.push_back(vector<int>());
+               fileOffsets.push_back(vector<MPI_Aint>());
+               roundBytes = 0;
+            }
+
+            MPI_Aint address;
+            MPI_Get_address(it->array,&address);
+            blockLengths.back().push_back(it->amount);
+            addresses.back().push_back(address);
+            types.back().push_back(it->mpiType);
+
+            // Merge file segments that are adjacent:
+            if (fileOffsets.back().size() > 0 && fileOffsets.back().back()+fileLengths.back().back() == fileOffset) {
+               fileLengths.back().back() += unitBytes;
+            } else {
+               fileOffsets.back().push_back(fileOffset);
+               fileLengths.back().push_back(unitBytes);
+            }
+            fileOffset += unitBytes;
+            roundBytes += unitBytes;
+         }
+         arrayOffset += totals[a+1];
+      }
+
+      // Reduce the maximum number of rounds to all processes to prevent deadlock:
+      uint64_t myRounds = blockLengths.size();
+      uint64_t N_rounds;
+      MPI_Allreduce(&myRounds,&N_rounds,1,MPI_Type<uint64_t>(),MPI_MAX,comm);
+
+      // Write data. Each round sets a file view that covers this process' 
+      // file segments, and writes all its multi-write units with a single 
+      // struct datatype with absolute addresses:
+      for (uint64_t r=0; r<N_rounds && dryRunning == false; ++r) {
+         MPI_Datatype memoryType = MPI_BYTE;
+         MPI_Datatype fileType = MPI_BYTE;
+         int count = 0;
+         if (r < myRounds && blockLengths[r].size() > 0) {
+            MPI_Type_create_struct(blockLengths[r].size(),&(blockLengths[r][0]),&(addresses[r][0]),&(types[r][0]),&memoryType);
+            MPI_Type_commit(&memoryType);
+            MPI_Type_create_hindexed(fileOffsets[r].size(),&(fileLengths[r][0]),&(fileOffsets[r][0]),MPI_BYTE,&fileType);
+            MPI_Type_commit(&fileType);
+            count = 1;
+         }
+
+         const double t_start = MPI_Wtime();
+         MPI_File_set_view(fileptr,0,MPI_BYTE,fileType,const_cast<char*>("native"),MPI_INFO_NULL);
+         if (MPI_File_write_at_all(fileptr,0,MPI_BOTTOM,count,memoryType,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+         MPI_File_set_view(fileptr,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),MPI_INFO_NULL);
+         writeTime += (MPI_Wtime() - t_start);
+
+         if (memoryType != MPI_BYTE) MPI_Type_free(&memoryType);
+         if (fileType != MPI_BYTE) MPI_Type_free(&fileType);
+      }
+
+      // Combine checksums of all arrays at master with a single reduction:
+      vector<uint64_t> arrayChecksums(2*N_arrays+1);
+      if (checksums == true && N_arrays > 0) {
+         vector<uint64_t> myChecksums(2*N_arrays);
+         for (size_t a=0; a<N_arrays; ++a) unitChecksum(batchArrays[a].units,&(myChecksums[2*a]));
+         if (reduceChecksums(&(myChecksums[0]),N_arrays,&(arrayChecksums[0]),masterRank,comm) == false) success = false;
+      }
+
+      // Combine statistics of all arrays at master with a single reduction. 
+      // Element a of statisticsOffsets is the first tuple of array a:
+      vector<size_t> statisticsOffsets(N_arrays+1,0);
+      for (size_t a=0; a<N_arrays; ++a) {
+         const BatchArray& array = batchArrays[a];
+         statisticsOffsets[a+1] = statisticsOffsets[a];
+         if (statistics == true && statisticsSupported(getVLSVDatatype(array.dataType),array.dataSize,array.vectorSize) == true) {
+            statisticsOffsets[a+1] += array.vectorSize;
+         }
+      }
+      vector<double> batchStatistics(4*statisticsOffsets[N_arrays]);
+      if (statisticsOffsets[N_arrays] > 0) {
+         vector<double> myStatistics(batchStatistics.size());
+         for (size_t a=0; a<N_arrays; ++a) {
+            if (statisticsOffsets[a+1] == statisticsOffsets[a]) continue;
+            unitStatistics(batchArrays[a].units,getVLSVDatatype(batchArrays[a].dataType),batchArrays[a].dataSize,
+                           batchArrays[a].vectorSize,&(myStatistics[4*statisticsOffsets[a]]));
+         }
+         if (reduceStatistics(&(myStatistics[0]),statisticsOffsets[N_arrays],&(batchStatistics[0]),masterRank,comm) == false) success = false;
+      }
+
+      // Insert footer entries for all arrays:
+      for (size_t a=0; a<N_arrays; ++a) {
+         arrayChecksum = arrayChecksums[2*a];
+         arrayStatistics.assign(batchStatistics.begin()+4*statisticsOffsets[a],batchStatistics.begin()+4*statisticsOffsets[a+1]);
+         dataType   = batchArrays[a].dataType;
+         vectorSize = batchArrays[a].vectorSize;
+         dataSize   = batchArrays[a].dataSize;
+         totalBytes = totals[a+1];
+         totalArrayBytes = totalBytes;
+         totalChunks = 0;
+         offset = alignOffset(offset);
+         if (multiwriteFooter(batchArrays[a].tagName,batchArrays[a].attribs) == false) success = false;
+         offset += totalBytes;
+      }
+      batchArrays.clear();
+
+      if (checkSuccess(success,comm) == false) return false;
+      return snapshotFooter();
+   }
+
+   /** Compress this process' multi-write units. Data is packed into a contiguous 
+    * buffer and split into chunks of whole array elements that are compressed 
+    * independently. Multi-write units are replaced by units that point to the 
+    * compressed data, and the size of each chunk is recorded in chunkTable.
+    * @return If true, data was compressed successfully.*/
+   bool Writer::compressMultiwriteUnits() {
+      compressionBuffer.clear();
+      chunkTable.clear();
+
+      const uint64_t bytes = multiwriteUnits[0].getBytes();
+      myBytes = bytes;
+      if (bytes == 0) {
+         multiwriteUnits[0].clear();
+         return true;
+      }
+      const uint64_t elementBytes = vectorSize*dataSize;
+      if (elementBytes == 0 || bytes % elementBytes != 0) return false;
+
+      // Pack multi-write units into a contiguous buffer, 
+      // unless the data already is in a single unit:
+      const char* input = multiwriteUnits[0].front().array;
+      if (multiwriteUnits[0].size() > 1) {
+         compressionInput.resize(bytes);
+         uint64_t packOffset = 0;
+         for (Multi_IO_Buffer::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+            int datatypeBytesize;
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            memcpy(&(compressionInput[packOffset]),it->array,it->amount*datatypeBytesize);
+            packOffset += it->amount*datatypeBytesize;
+         }
+         input = &(compressionInput[0]);
+      }
+
+      // Compress data in chunks of whole array elements:
+      uint64_t chunkElements = compressionChunkBytes / elementBytes;
+      if (chunkElements == 0) chunkElements = 1;
+      const uint64_t N_elements = bytes / elementBytes;
+      const uint64_t N_chunks = (N_elements + chunkElements - 1) / chunkElements;
+      compressionBuffer.resize(N_chunks*getCompressBound(compressionMethod,chunkElements*elementBytes));
+      chunkTable.resize(2*N_chunks);
+
+      uint64_t compressedBytes = 0;
+      for (uint64_t c=0; c<N_chunks; ++c) {
+         uint64_t elements = chunkElements;
+         if ((c+1)*chunkElements > N_elements) elements = N_elements - c*chunkElements;
+
+         uint64_t storedBytes;
+         if (compressChunk(compressionMethod,input+c*chunkElements*elementBytes,elements*elementBytes,dataSize,
+                           &(compressionBuffer[compressedBytes]),storedBytes,compressionWorkspace) == false) return false;
+         chunkTable[2*c+0] = elements;
+         chunkTable[2*c+1] = storedBytes;
+         compressedBytes += storedBytes;
+      }
+      compressionBuffer.resize(compressedBytes);
+
+      // Replace multi-write units with units pointing to compressed data:
+      multiwriteUnits[0].clear();
+      const uint64_t maxBytes = getMaxBytesPerWrite();
+      for (uint64_t i=0; i<compressedBytes; i+=maxBytes) {
+         uint64_t unitBytes = maxBytes;
+         if (i+unitBytes > compressedBytes) unitBytes = compressedBytes - i;
+         multiwriteUnits[0].push_back(Multi_IO_Unit(&(compressionBuffer[i]),MPI_BYTE,unitBytes));
       }
       return true;
    }
@@ -110,85 +776,132 @@ namespace vlsv {
    /** Close a file that has been previously opened by calling Writer::open.
     * After the file has been closed the MPI master process appends an XML footer 
     * to the end of the file, and writes an offset to the footer to the start of 
-    * the file.
+    * the file. Arrays queued in batch mode are written first, see commitBatch. If a 
+    * pending asynchronous write or the batch fails on any process, or the footer 
+    * cannot be written, the header is not updated to point to the footer and this 
+    * function returns false on all processes.
     * @return If true, the file was closed successfully. If false, a file may not 
-    * have been opened successfully by Writer::open.*/
+    * have been opened successfully by Writer::open, pending array data could not 
+    * be written, or the footer could not be written.*/
    bool Writer::close() {
       // If a file was never opened, exit immediately:
       if (fileOpen == false) return false;
 
-      // Wait until all processes have finished writing data to file.
-      // This is important to ensure that MPI_File_seek below will 
-      // read the correct file size.
-      MPI_Barrier(comm);
-      
-      MPI_Offset viewOffset;
-      MPI_Offset endOffset;
+      // Complete all pending asynchronous writes and batched arrays before the footer is written. 
+      // Footer entries of asynchronously written and batched arrays already exist, thus the 
+      // footer is not written if the data of any process failed to write:
+      bool success = true;
+      if (waitAll() == false) success = false;
+      if (batchMode == true) {
+         if (commitBatch() == false) success = false;
+      }
+      success = checkSuccess(success,comm);
+
+      // Footer is written after the last array. All processes know 
+      // its position so there is no need to query the file size:
+      const MPI_Offset endOffset = offset;
+
+      // Master process writes the footer index followed by the footer:
+      uint64_t bytesIndex = 0;
+      uint64_t bytesFooter = 0;
+      if (myrank == masterRank && success == true) {
+         bytesIndex = writeFooterIndex(endOffset);
+         if (writeFooter(*xmlWriter,endOffset+bytesIndex,bytesFooter) == false) success = false;
+      }
 
-      // Write the footer using collective MPI file operations. Only the master process 
-      // actually writes something. Using collective MPI here practically eliminated 
-      // all time spent here.
-      if (myrank != masterRank) {
-         if (dryRunning == false) {
-            //Write zero length data
-            MPI_File_write_at_all(fileptr,0,NULL,0,MPI_BYTE,MPI_STATUSES_IGNORE);
-         }
-      } else {
-         if (dryRunning == false) {
-            MPI_File_seek(fileptr,0,MPI_SEEK_END);
-            MPI_File_get_position(fileptr,&viewOffset);
-            MPI_File_get_byte_offset(fileptr,viewOffset,&endOffset);
-         }
+      // Master knows the file size after the footer has been written, and it is 
+      // broadcast together with the status of the footer write. If the file was 
+      // preallocated, or appended to, and its size differs it is truncated:
+      uint64_t footerStatus[2];
+      footerStatus[0] = endOffset + bytesIndex + bytesFooter;
+      footerStatus[1] = (success == true) ? 0 : 1;
+      MPI_Bcast(footerStatus,2,MPI_Type<uint64_t>(),masterRank,comm);
+      const uint64_t fileSize = footerStatus[0];
+      if (footerStatus[1] != 0) success = false;
+      if (dryRunning == false && preallocatedBytes > 0 && static_cast<uint64_t>(preallocatedBytes) != fileSize) {
+         MPI_File_set_size(fileptr,fileSize);
+      }
 
-         // Print the footer to a stringstream first and then grab a 
-         // pointer for writing it to the file:
-         stringstream footerStream;
-         xmlWriter->print(footerStream);
-         string footerString = footerStream.str();
-         
-         double t_start = MPI_Wtime();
-         if (dryRunning == false) {
-            MPI_File_write_at_all(fileptr,endOffset,(char*)footerString.c_str(),footerString.size(),MPI_BYTE,MPI_STATUSES_IGNORE);
-         }
-         writeTime += (MPI_Wtime() - t_start);
-         bytesWritten += footerStream.str().size();
+      // Layout of this file replaces the previous layout:
+      if (layout != NULL) {
+         layout->reused = (layout->fileSize == fileSize && layout->arrayOffsets == layoutOffsets);
+         layout->arrayOffsets.swap(layoutOffsets);
+         layout->fileSize = fileSize;
       }
 
-      // Close MPI file:
+      // Close MPI file and subfile:
       MPI_Barrier(comm);
       if (dryRunning == false) MPI_File_close(&fileptr);
+      if (subfileComm != MPI_COMM_NULL) {
+         if (dryRunning == false) MPI_File_close(&subfilePtr);
+         MPI_Comm_free(&subfileComm);
+      }
 
-      // Master process writes footer offset to the start of file
-      if (myrank == masterRank && dryRunning == false) {
+      // Master process writes footer index offset and footer offset to the start of file, 
+      // a footer that was not written completely is never pointed to:
+      if (myrank == masterRank && dryRunning == false && success == true) {
          fstream footer;
-         size_t footerOffset = (size_t)endOffset;
+         uint64_t footerOffset = endOffset + bytesIndex;
+         char header[2*sizeof(uint64_t)];
+         setFooterIndexOffset(header,(bytesIndex > 0) ? endOffset : 0);
+         memcpy(header+sizeof(uint64_t),&footerOffset,sizeof(uint64_t));
          
          footer.open(fileName.c_str(),fstream::in | fstream::out | fstream::binary | fstream::ate);
-         char* ptr = reinterpret_cast<char*>(&footerOffset);
-         footer.seekp(sizeof(uint64_t));
-         footer.write(ptr,sizeof(uint64_t));
+         footer.seekp(1);
+         footer.write(header+1,sizeof(header)-1);
+         if (footer.good() == false) success = false;
          footer.close();
       }
 
       initialized = false;
-      delete [] blockLengths; blockLengths = NULL;
-      delete [] bytesPerProcess; bytesPerProcess = NULL;
-      delete [] displacements; displacements = NULL;
-      delete [] offsets; offsets = NULL;
-      delete [] types; types = NULL;
       delete xmlWriter; xmlWriter = NULL;
 
-      // Wait for master process to finish:
-      MPI_Barrier(comm);
+      // Wait for master process to finish and receive its status:
+      unsigned char masterSuccess = (success == true) ? 1 : 0;
+      MPI_Bcast(&masterSuccess,1,MPI_Type<unsigned char>(),masterRank,comm);
       fileOpen = false;
       MPI_Comm_free(&comm);
-      return true;
+      if (aggregationComm != MPI_COMM_NULL) MPI_Comm_free(&aggregationComm);
+      vector<char>().swap(aggregationBuffer);
+      return masterSuccess == 1;
    }
    
    void Writer::endDryRunning() {
       dryRunning = false;
    }
    
+   /** Check if the current array is identical to an array recorded in the history. 
+    * Each process compares its own data to its part of the recorded array, and the 
+    * array matches if the data of all processes matches. If it does, referenceFile 
+    * and referenceOffset are set. This function must be called by all processes.
+    * @param key Key of the array, see getHistoryKey.
+    * @param myHash Hash of the data this process writes.
+    * @param success Success status of this process, replaced by the global status.
+    * @return If true, the array matches the recorded array.*/
+   bool Writer::findReference(const std::string& key,const uint64_t& myHash,bool& success) {
+      int myStatus[2];
+      myStatus[0] = (success == true) ? 1 : 0;
+      myStatus[1] = 0;
+      map<string,WriteHistory::Array>::const_iterator it = history->arrays.find(key);
+      if (it != history->arrays.end()) {
+         const WriteHistory::Array& array = it->second;
+         if (array.dataType == dataType && array.vectorSize == vectorSize && array.dataSize == dataSize 
+             && array.totalBytes == totalBytes && array.myOffset == static_cast<uint64_t>(myOffset) 
+             && array.myBytes == myBytes && array.myHash == myHash) myStatus[1] = 1;
+      }
+
+      int globalStatus[2];
+      MPI_Allreduce(myStatus,globalStatus,2,MPI_INT,MPI_MIN,comm);
+      success = (globalStatus[0] == 1);
+      if (success == false || globalStatus[1] == 0) return false;
+
+      referenceFile = it->second.fileName;
+      referenceOffset = it->second.offset;
+      ++(history->referencedArrays);
+      history->referencedBytes += totalArrayBytes;
+      return true;
+   }
+
    /** Get the total amount of bytes written to VLSV file. This function 
     * returns a meaningful value at master process only.
     * @return Total number of bytes written to output files by all processes.*/
@@ -199,17 +912,55 @@ namespace vlsv {
     * @return Time spent in file I/O in seconds.*/
    double Writer::getWriteTime() const {return writeTime;}
 
+   /** Get the index of the calling thread in per-thread multi-write storage. This is 
+    * not defined in the header, so that the library and the application may be 
+    * compiled with different OpenMP settings.
+    * @return OpenMP thread number of the calling thread, or zero if OpenMP is not used.*/
+   int Writer::getThreadIndex() const {
+      #ifdef _OPENMP
+         return omp_get_thread_num();
+      #else
+         return 0;
+      #endif
+   }
+
+   /** Get the per-thread multi-write storage of the calling thread. A thread that has 
+    * no storage, e.g. because the parallel region has more threads than startMultiwrite 
+    * prepared storage for, cannot record its units. The failure is recorded so that 
+    * endMultiwrite fails on all processes instead of writing an array with a hole in it.
+    * @return Multi-write units of the calling thread, or NULL if the thread has no storage.*/
+   Multi_IO_Buffer* Writer::getThreadUnits() {
+      const size_t thread = getThreadIndex();
+      if (thread < multiwriteUnits.size()) return &(multiwriteUnits[thread]);
+      #ifdef _OPENMP
+         #pragma omp atomic write
+      #endif
+      multiwriteFailed = true;
+      return NULL;
+   }
+
    /** Open a VLSV file for parallel output. The file is opened on all processes 
     * in the given communicator. Additionally, master MPI process writes a 
     * header into the output file and caches a footer which will be written 
     * in Writer::close. If a file has already been opened and Writer::open 
     * is called again, the currently open file is closed before the new file is opened.
+    * 
+    * In append mode an existing VLSV file is opened instead of creating a new one. Master 
+    * process reads the footer of the file, new arrays are written starting from the 
+    * position of the old footer, and an extended footer is written in Writer::close. 
+    * Arrays already in the file are not touched. If the file was written in subfiling 
+    * mode, new array data is appended to the end of the existing subfiles.
+    * 
+    * If a hint cache has been set, tuned hints of the current job geometry are 
+    * added to mpiInfo, see setHintCache.
     * @param fname The name of the output file.
     * @param comm MPI communicator used in writing.
     * @param masterProcessID ID of the MPI master process.
     * @param mpiInfo MPI info, passed on to MPI_File_open.
+    * @param append If true, arrays are appended to an existing file.
     * @return If true, a file was opened successfully.*/
-   bool Writer::open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo) {
+   bool Writer::open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo,
+                     const bool& append) {
       bool success = true;
    
       // If a file with the same name has already been opened, return immediately.
@@ -225,37 +976,158 @@ namespace vlsv {
       MPI_Comm_size(this->comm,&N_processes);
       bytesWritten = 0;
       writeTime = 0;
+      arraysSinceSnapshot = 0;
+      snapshotOffset = 0;
+      snapshotTags.clear();
+      if (history != NULL) {
+         history->referencedArrays = 0;
+         history->referencedBytes = 0;
+
+         // A file that is not appended to is overwritten, thus arrays recorded
+         // from it no longer exist and must not be referenced:
+         if (append == false) {
+            map<string,WriteHistory::Array>::iterator it = history->arrays.begin();
+            while (it != history->arrays.end()) {
+               if (it->second.fileName == fname) history->arrays.erase(it++);
+               else ++it;
+            }
+         }
+      }
+
+      // Hints loaded from the hint cache are used in place of mpiInfo until the next file is opened:
+      if (hintInfo != MPI_INFO_NULL) MPI_Info_free(&hintInfo);
+      if (hintCache.empty() == false) {
+         loadTunedHints(hintCache,this->comm,mpiInfo,hintInfo);
+         mpiInfo = hintInfo;
+      }
 
       // Allocate per-thread storage:
       multiwriteOffsets.resize(1);
       multiwriteUnits.resize(1);
 
+      // In append mode master reads the footer of the existing file and 
+      // broadcasts its position, zero value indicates a failure:
+      uint64_t footerOffset = 0;
+      if (append == true) {
+         if (myrank == masterRank) {
+            if (readFooter(fname,footerOffset) == false) footerOffset = 0;
+         }
+         MPI_Bcast(&footerOffset,1,MPI_Type<uint64_t>(),masterRank,this->comm);
+         if (footerOffset == 0) {
+            MPI_Comm_free(&(this->comm));
+            fileOpen = false;
+            return fileOpen;
+         }
+      }
+
+      // In subfiling mode processes are split into groups of consecutive processes, 
+      // each group writes its data to its own subfile:
+      subfileArray = false;
+      subfileOffset = 0;
+      if (subfileComm != MPI_COMM_NULL) MPI_Comm_free(&subfileComm);
+      if (subfiles > 1 && N_processes > 1) {
+         subfileIndex = (static_cast<int64_t>(myrank)*min(subfiles,N_processes)) / N_processes;
+         MPI_Comm_split(this->comm,subfileIndex,myrank,&subfileComm);
+      }
+
+      // Split processes into aggregation groups. Each shared memory node 
+      // has aggregatorsPerNode groups consisting of consecutive processes. 
+      // Aggregation groups never span several subfiles:
+      if (aggregationComm != MPI_COMM_NULL) MPI_Comm_free(&aggregationComm);
+      if (aggregatorsPerNode > 0) {
+         MPI_Comm nodeComm;
+         int nodeRank,nodeSize;
+         MPI_Comm parentComm = (subfileComm != MPI_COMM_NULL) ? subfileComm : this->comm;
+         MPI_Comm_split_type(parentComm,MPI_COMM_TYPE_SHARED,myrank,MPI_INFO_NULL,&nodeComm);
+         MPI_Comm_rank(nodeComm,&nodeRank);
+         MPI_Comm_size(nodeComm,&nodeSize);
+         const int group = (static_cast<int64_t>(nodeRank)*aggregatorsPerNode) / nodeSize;
+         MPI_Comm_split(nodeComm,group,nodeRank,&aggregationComm);
+         MPI_Comm_free(&nodeComm);
+      }
+
       // All processes in communicator comm open the same file. If a file with the 
-      // given name already exists it is deleted. Note: We found out that MPI_File_open 
-      // failed quite often in meteo, at least when writing many small files. It was 
-      // possibly caused by MPI_File_delete call, that's the reason for the barrier.
+      // given name already exists it is deleted, unless arrays are appended to it. 
+      // Note: We found out that MPI_File_open failed quite often in meteo, at least 
+      // when writing many small files. It was possibly caused by MPI_File_delete 
+      // call, that's the reason for the barrier.
       int accessMode = (MPI_MODE_WRONLY | MPI_MODE_CREATE);
+      if (append == true) accessMode = MPI_MODE_WRONLY;
       fileName = fname;
+      layoutOffsets.clear();
+      preallocatedBytes = 0;
       if (dryRunning == false) {
-         if (myrank == masterRank) MPI_File_delete(const_cast<char*>(fname.c_str()),mpiInfo);
+         // If the layout of the previous file is known, striping hints are derived from its size:
+         MPI_Info fileInfo = mpiInfo;
+         if (layout != NULL && layout->fileSize > 0) createStripingInfo(mpiInfo,layout->fileSize,N_processes,fileInfo);
+
+         if (myrank == masterRank && append == false) MPI_File_delete(const_cast<char*>(fname.c_str()),mpiInfo);
          MPI_Barrier(comm);
-         if (MPI_File_open(comm,const_cast<char*>(fileName.c_str()),accessMode,mpiInfo,&fileptr) != MPI_SUCCESS) {
+         const int rvalue = MPI_File_open(comm,const_cast<char*>(fileName.c_str()),accessMode,fileInfo,&fileptr);
+         if (fileInfo != mpiInfo) MPI_Info_free(&fileInfo);
+         if (rvalue != MPI_SUCCESS) {
+            delete xmlWriter; xmlWriter = NULL;
             fileOpen = false;
             return fileOpen;
          }
-      }
 
-      offset = 0;           //offset set to 0 when opening a new file
-      if (dryRunning == false) MPI_File_set_view(fileptr,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),mpiInfo);
+         // Set the file to its expected final size at once so that it does not 
+         // grow incrementally. Size is corrected in close if the layout changes. 
+         // An appended file keeps its size, and is truncated in close if the 
+         // extended footer ends before the end of the old file:
+         if (append == true) {
+            MPI_File_get_size(fileptr,&preallocatedBytes);
+         } else if (layout != NULL && layout->fileSize > 0) {
+            int sizeResult;
+            if (preallocate == true) sizeResult = MPI_File_preallocate(fileptr,layout->fileSize);
+            else sizeResult = MPI_File_set_size(fileptr,layout->fileSize);
+            if (sizeResult == MPI_SUCCESS) preallocatedBytes = layout->fileSize;
+         }
 
-      // Only master process needs these arrays:
-      if (myrank == masterRank) {
-         offsets = new MPI_Offset[N_processes];
-         bytesPerProcess = new uint64_t[N_processes];    
+         // Each group of processes opens its own subfile:
+         if (subfileComm != MPI_COMM_NULL) {
+            const string subfileName = getSubfileName(fileName,subfileIndex);
+            int subfileRank;
+            MPI_Comm_rank(subfileComm,&subfileRank);
+            if (subfileRank == 0 && append == false) MPI_File_delete(const_cast<char*>(subfileName.c_str()),mpiInfo);
+            MPI_Barrier(subfileComm);
+
+            // Appended data is written after the existing data in the subfile, 
+            // a subfile that does not exist yet is created:
+            bool subfileOpen = true;
+            if (MPI_File_open(subfileComm,const_cast<char*>(subfileName.c_str()),(MPI_MODE_WRONLY | MPI_MODE_CREATE),
+                              mpiInfo,&subfilePtr) != MPI_SUCCESS) {
+               subfileOpen = false;
+            } else if (append == true) {
+               MPI_File_get_size(subfilePtr,&subfileOffset);
+            }
+            if (checkSuccess(subfileOpen,this->comm) == false) {
+               if (subfileOpen == true) MPI_File_close(&subfilePtr);
+               MPI_File_close(&fileptr);
+               MPI_Comm_free(&subfileComm);
+               delete xmlWriter; xmlWriter = NULL;
+               fileOpen = false;
+               return fileOpen;
+            }
+         }
+      }
+
+      // Resolve array alignment. Striping unit reported by master is used on all processes:
+      alignment = alignmentRequest;
+      if (alignmentRequest == STRIPE_ALIGNMENT) {
+         if (myrank == masterRank) alignment = getStripingUnit(dryRunning == false ? fileptr : MPI_FILE_NULL,mpiInfo);
+         MPI_Bcast(&alignment,1,MPI_Type<uint64_t>(),masterRank,this->comm);
       }
+
+      // Data starts after the header that master writes below, or in append mode at the 
+      // position of the old footer. All processes keep a running count of the output file size:
+      offset = 2*sizeof(uint64_t);
+      if (append == true) offset = footerOffset;
+      if (dryRunning == false) MPI_File_set_view(fileptr,0,MPI_BYTE,MPI_BYTE,const_cast<char*>("native"),mpiInfo);
       
-      // Master process opens an XML tree for storing the footer:
-      if (myrank == masterRank) {
+      // Master process opens an XML tree for storing the footer. 
+      // In append mode the footer was read from the file above:
+      if (myrank == masterRank && append == false) {
          xmlWriter     = new muxml::MuXML();
          muxml::XMLNode* root = xmlWriter->getRoot();
          xmlWriter->addNode(root,"VLSV","");
@@ -263,8 +1135,8 @@ namespace vlsv {
 
       // Master writes 2 64bit integers to the start of file. 
       // Second value will be overwritten in close() function to tell 
-      // the position of footer:
-      if (myrank == masterRank) {
+      // the position of footer. An appended file already has a header:
+      if (myrank == masterRank && append == false) {
          // Write file endianness to the first byte:
          uint64_t endianness = 0;
          unsigned char* ptr = reinterpret_cast<unsigned char*>(&endianness);
@@ -275,7 +1147,6 @@ namespace vlsv {
             if (MPI_File_write_at(fileptr,8,&endianness,1,MPI_Type<uint64_t>(),MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
          }
          writeTime += (MPI_Wtime() - t_start);
-         offset += 2*sizeof(uint64_t); //only master rank keeps a running count
          bytesWritten += 2*sizeof(uint64_t);
       }
 
@@ -284,11 +1155,10 @@ namespace vlsv {
       MPI_Bcast(&success,sizeof(bool),MPI_BYTE,masterRank,comm);   
       if (success == false) {
          if (dryRunning == false) {
+            if (subfileComm != MPI_COMM_NULL) MPI_File_close(&subfilePtr);
             MPI_File_close(&fileptr);
             MPI_File_delete(const_cast<char*>(fileName.c_str()),MPI_INFO_NULL);
          }
-         delete [] offsets; offsets = NULL;
-         delete [] bytesPerProcess; bytesPerProcess = NULL;
          delete xmlWriter; xmlWriter = NULL;
       }
 
@@ -297,6 +1167,308 @@ namespace vlsv {
       return fileOpen;
    }
 
+   /** Read the footer of an existing VLSV file into xmlWriter, called by master 
+    * process when a file is opened in append mode. If the footer has a binary 
+    * index, appended data overwrites the index as well as the footer. If the file 
+    * was not closed properly, the footer is merged from the chain of footer snapshots 
+    * that ends at the snapshot pointed to by the header, see footersnapshot in vlsv_common.h.
+    * @param fname Name of the VLSV file.
+    * @param footerOffset Position where appended data is written, i.e., position 
+    * of the footer or its index, is written here.
+    * @return If true, the footer was read successfully.*/
+   bool Writer::readFooter(const std::string& fname,uint64_t& footerOffset) {
+      fstream in;
+      in.open(fname.c_str(),fstream::in | fstream::binary);
+      if (in.good() == false) {
+         cerr << "ERROR in vlsv::Writer! Could not open file '" << fname << "' for appending" << endl;
+         return false;
+      }
+
+      // Arrays can only be appended to files written in the same endianness:
+      uint64_t header[2];
+      in.read(reinterpret_cast<char*>(header),sizeof(header));
+      const unsigned char* ptr = reinterpret_cast<const unsigned char*>(header);
+      if (in.good() == false || ptr[0] != detectEndianness()) {
+         cerr << "ERROR in vlsv::Writer! File '" << fname << "' has a different endianness or it is not a VLSV file" << endl;
+         return false;
+      }
+
+      // Files that were not closed properly have no footer:
+      footerOffset = header[1];
+      in.seekg(0,fstream::end);
+      const uint64_t fileSize = in.tellg();
+      if (footerOffset < 2*sizeof(uint64_t) || footerOffset >= fileSize) {
+         cerr << "ERROR in vlsv::Writer! File '" << fname << "' has no footer" << endl;
+         return false;
+      }
+
+      // Snapshots are read newest first until a complete footer is reached:
+      bool success = true;
+      vector<muxml::MuXML*> snapshots;
+      uint64_t snapshotOffset = footerOffset;
+      while (true) {
+         muxml::MuXML* snapshot = new muxml::MuXML();
+         snapshots.push_back(snapshot);
+         in.clear();
+         in.seekg(snapshotOffset);
+         if (snapshot->parse(in,footerBuffer) == false || snapshot->find("VLSV",snapshot->getRoot()) == NULL) {
+            success = false; break;
+         }
+         const uint64_t previousOffset = getPreviousFooterOffset(*snapshot);
+         if (previousOffset == 0) break;
+
+         // Snapshots are written in file order, thus the chain cannot loop:
+         if (previousOffset >= snapshotOffset) {
+            success = false; break;
+         }
+         snapshotOffset = previousOffset;
+      }
+      xmlWriter = new muxml::MuXML();
+      if (success == true) mergeFooterSnapshots(snapshots,*xmlWriter);
+      for (size_t s=0; s<snapshots.size(); ++s) delete snapshots[s];
+      if (success == false) {
+         cerr << "ERROR in vlsv::Writer! Could not read footer of file '" << fname << "'" << endl;
+         delete xmlWriter; xmlWriter = NULL;
+         return false;
+      }
+
+      // Index is reclaimed only if it belongs to the footer, i.e., it is not a 
+      // stale index left in the file by an earlier footer snapshot:
+      const uint64_t indexOffset = getFooterIndexOffset(reinterpret_cast<const char*>(header));
+      if (indexOffset >= 2*sizeof(uint64_t) && indexOffset < footerOffset) {
+         char indexHeader[footerindex::HEADER_BYTES];
+         in.clear();
+         in.seekg(indexOffset);
+         in.read(indexHeader,sizeof(indexHeader));
+         uint64_t indexedFooter = 0;
+         memcpy(&indexedFooter,indexHeader+strlen(footerindex::MAGIC),sizeof(uint64_t));
+         if (in.good() == true && memcmp(indexHeader,footerindex::MAGIC,strlen(footerindex::MAGIC)) == 0 
+             && indexedFooter == footerOffset) {
+            footerOffset = indexOffset;
+         }
+      }
+      return true;
+   }
+
+   /** Record the current array in the history after its data has been written. 
+    * An array that was stored as a reference is not recorded, i.e., references 
+    * always point to the file that contains the data.
+    * @param key Key of the array, see getHistoryKey.
+    * @param arrayOffset File offset of the array.
+    * @param myHash Hash of the data this process wrote.*/
+   void Writer::recordArray(const std::string& key,const MPI_Offset& arrayOffset,const uint64_t& myHash) {
+      WriteHistory::Array& array = history->arrays[key];
+      array.fileName   = fileName;
+      array.offset     = arrayOffset;
+      array.dataType   = dataType;
+      array.vectorSize = vectorSize;
+      array.dataSize   = dataSize;
+      array.totalBytes = totalBytes;
+      array.myOffset   = myOffset;
+      array.myBytes    = myBytes;
+      array.myHash     = myHash;
+   }
+
+   /** Pack this process' multi-write units into precisionBuffer while rounding the mantissas 
+    * of floating point values and/or narrowing double precision values to floats. 
+    * Multi-write units are replaced by units that point to the packed data.
+    * @return If true, data was packed successfully.*/
+   bool Writer::reducePrecision() {
+      const bool narrow = (storeAsFloat == true && dataSize == sizeof(double));
+      if (dataSize != sizeof(float) && dataSize != sizeof(double)) return false;
+
+      uint64_t N_values = 0;
+      for (Multi_IO_Buffer::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+         N_values += it->amount;
+      }
+      uint64_t storedDataSize = dataSize;
+      if (narrow == true) storedDataSize = sizeof(float);
+      precisionBuffer.resize(N_values*storedDataSize);
+
+      // Round (and narrow) each unit to the buffer:
+      uint64_t value = 0;
+      for (Multi_IO_Buffer::const_iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
+         char* output = &(precisionBuffer[value*storedDataSize]);
+         if (narrow == true) {
+            narrowToFloat(reinterpret_cast<double*>(it->array),it->amount,mantissaBits,reinterpret_cast<float*>(output));
+         } else if (dataSize == sizeof(double)) {
+            roundMantissa(reinterpret_cast<double*>(it->array),it->amount,mantissaBits,reinterpret_cast<double*>(output));
+         } else {
+            roundMantissa(reinterpret_cast<float*>(it->array),it->amount,mantissaBits,reinterpret_cast<float*>(output));
+         }
+         value += it->amount;
+      }
+
+      // Replace multi-write units with units pointing to packed data:
+      multiwriteUnits[0].clear();
+      dataSize = storedDataSize;
+      const MPI_Datatype mpiType = getMPIDatatype(vlsvType,dataSize);
+      const uint64_t maxValues = getMaxBytesPerWrite() / dataSize;
+      for (uint64_t i=0; i<N_values; i+=maxValues) {
+         uint64_t amount = maxValues;
+         if (i+amount > N_values) amount = N_values - i;
+         multiwriteUnits[0].push_back(Multi_IO_Unit(&(precisionBuffer[i*dataSize]),mpiType,amount));
+      }
+      return true;
+   }
+
+   /** Align the start of each array written after the next open. Arrays start at 
+    * file offsets that are multiples of the given value, and the gaps between arrays 
+    * are left unwritten. Aligning arrays to file system stripes or blocks prevents 
+    * writers of consecutive arrays from contending for the same stripe locks. 
+    * Array offsets are stored in the footer as before, thus readers are not affected. 
+    * In subfiling mode the segments in subfiles are aligned as well. Data of an array 
+    * is contiguous in the file, so the parts written by each process are not aligned. 
+    * This function must be called by all processes before open.
+    * @param bytes Alignment in bytes, zero disables alignment. If STRIPE_ALIGNMENT, the 
+    * striping unit of the output file is used, see getStripingUnit.*/
+   void Writer::setAlignment(const uint64_t& bytes) {
+      alignmentRequest = bytes;
+   }
+
+   /** Enable or disable checksums of arrays written after this call. If enabled, 
+    * each process calculates a CRC32C checksum of the data it writes, and the 
+    * checksums are combined into a checksum of the whole array that is stored 
+    * in the footer, see vlsv_checksum.h. Readers can then verify that the array 
+    * has not been corrupted. This function must be called by all processes.
+    * @param enabled If true, checksums are calculated.*/
+   void Writer::setChecksums(const bool& enabled) {
+      checksums = enabled;
+   }
+
+   /** Set the compression method used for arrays written after this call. Each
+    * process compresses its part of an array in chunks of approximately chunkBytes
+    * bytes, and the chunk sizes are recorded in the file so that readers only need
+    * to decompress the chunks they read, see vlsv_compression.h. Compressed arrays
+    * are always written with blocking writes, and arrays queued in batch mode are
+    * written uncompressed. All processes must use the same settings.
+    * @param method Compression method, compression::NONE disables compression.
+    * @param chunkBytes Approximate number of uncompressed bytes in each chunk.
+    * Smaller chunks make partial reads cheaper but compress less efficiently.
+    * @return If false, this build of VLSV does not support the given method
+    * and compression was disabled.*/
+   bool Writer::setCompression(const compression::type& method,const uint64_t& chunkBytes) {
+      compressionMethod = compression::NONE;
+      compressionChunkBytes = chunkBytes;
+      if (compressionChunkBytes == 0) compressionChunkBytes = 1;
+      if (compressionSupported(method) == false) return false;
+      compressionMethod = method;
+      return true;
+   }
+
+   /** Set the number of arrays written between footer snapshots. A footer snapshot 
+    * is the footer of the arrays written so far. It is written after the last array, 
+    * and the footer offset in the file header is then updated to point to it, thus 
+    * if the program crashes before Writer::close the file can still be read up to the 
+    * most recent snapshot. Snapshots also let Reader::refresh follow a file that is 
+    * still being written. Snapshots are never overwritten. The first snapshot is the 
+    * complete footer, each later snapshot only contains the arrays written after the 
+    * previous one and a pointer to it, thus snapshots take space in proportion to the 
+    * number of arrays. Pending asynchronous writes are completed before a snapshot is written. 
+    * This function must be called by all processes.
+    * @param arrays Number of arrays between snapshots, zero value disables snapshots.*/
+   void Writer::setFooterInterval(const uint64_t& arrays) {
+      footerInterval = arrays;
+
+      // New arrays are not tracked while snapshots are disabled, the next snapshot is complete:
+      if (footerInterval == 0) {
+         snapshotOffset = 0;
+         snapshotTags.clear();
+      }
+   }
+
+   /** Set the method used to transfer multi-write units to MPI in a single collective 
+    * write. By default the method is selected for each write based on the number and 
+    * mean size of units, see selectIOStrategy. The setting takes effect immediately.
+    * @param strategy Transfer method.*/
+   void Writer::setIOStrategy(const iostrategy::type& strategy) {
+      ioStrategy = strategy;
+   }
+
+   /** Record the byte layout of the files written by this Writer, and use the layout 
+    * of the previous file to prepare the next one. When a file is closed its layout 
+    * (array offsets and file size) is stored in the given layout. When the next file 
+    * is opened, striping hints (striping_factor and striping_unit) are derived from 
+    * the recorded file size, and the file is set to that size before any data is 
+    * written. This avoids incremental file growth when consecutive files have the 
+    * same layout, as is typical for simulation output. If the layout changes the file 
+    * is truncated to the correct size in close. The layout can be recorded without 
+    * writing anything with a dry run, see startDryRun. This function must be called 
+    * by all processes before open, and the layout must exist until the file is closed.
+    * @param layout Layout used for the next file and updated in close, NULL disables layout recording.
+    * @param preallocate If true, file blocks are reserved with MPI_File_preallocate, which 
+    * may write the whole file on some file systems. Otherwise only the file size is set.*/
+   void Writer::setLayout(WriteLayout* layout,const bool& preallocate) {
+      this->layout = layout;
+      this->preallocate = preallocate;
+   }
+
+   /** Store arrays that are identical to an array in an earlier file as references. 
+    * Each process hashes the data it writes, and if the data of all processes matches 
+    * an array with the same tag name and attributes in the history, a footer entry 
+    * that refers to the earlier file (attribute 'file') is written instead of the 
+    * data. Readers follow references transparently. Arrays whose data is written 
+    * are recorded in the history. Compressed arrays, arrays written in batch mode 
+    * or to subfiles are always written. Referenced files must not be removed, and 
+    * they should be in the same directory as the referring file, or written with 
+    * absolute paths. Recorded arrays of a file are removed from the history when the 
+    * file is opened again without append. This function must be called by all processes before open, 
+    * and the history must exist until the file is closed.
+    * @param history History of written arrays, NULL disables references.*/
+   void Writer::setHistory(WriteHistory* history) {
+      this->history = history;
+   }
+
+   /** Enable or disable the binary footer index. The index is written before the 
+    * XML footer, and readers that understand it load the footer with a single read 
+    * without parsing XML, see footerindex in vlsv_common.h. Other readers use the 
+    * XML footer. The index is enabled by default. This function must be called before close.
+    * @param enabled If true, the footer index is written.*/
+   void Writer::setFooterIndex(const bool& enabled) {
+      footerIndex = enabled;
+   }
+
+   /** Set the hint cache from which MPI-IO hints tuned for the current job geometry 
+    * are loaded when a file is opened. Cached hints are added to the MPI info given 
+    * to open, but they never override hints given by the user. The cache is created 
+    * with tuneHints and saveTunedHints, or with the vlsvtune utility, see vlsv_hints.h.
+    * This function must be called by all processes before open.
+    * @param fileName Name of the hint cache file, empty string disables the cache.*/
+   void Writer::setHintCache(const std::string& fileName) {
+      hintCache = fileName;
+   }
+
+   /** Enable or disable node-level aggregation of written data. In node-level
+    * aggregation the processes on each shared memory node are split into 
+    * aggregatorsPerNode groups. Data of all processes in a group is gathered 
+    * to an aggregator process, who writes it to the output file. This reduces 
+    * the number of file system clients when each process writes many small pieces 
+    * of data. The setting takes effect when the next file is opened.
+    * @param aggregatorsPerNode Number of aggregator processes per node, zero 
+    * value disables node-level aggregation.*/
+   void Writer::setNodeAggregation(const int& aggregatorsPerNode) {
+      this->aggregatorsPerNode = aggregatorsPerNode;
+      if (this->aggregatorsPerNode < 0) this->aggregatorsPerNode = 0;
+   }
+
+   /** Set the precision of floating point arrays written after this call. Mantissas 
+    * are rounded to nearest when the data is packed for writing, user data is not 
+    * modified. Rounded data compresses much better, see setCompression. The number 
+    * of kept mantissa bits (and the original datasize of narrowed arrays) is recorded 
+    * in the footer. Arrays with reduced precision are always written with blocking writes, 
+    * and arrays queued in batch mode are written with full precision. 
+    * All processes must use the same settings.
+    * @param mantissaBits Number of mantissa bits kept, the relative error of each value is 
+    * at most 2^-(mantissaBits+1). A negative value disables rounding.
+    * @param storeAsFloat If true, double precision arrays are stored as single precision floats.
+    * @return If true, precision was set successfully.*/
+   bool Writer::setPrecision(const int& mantissaBits,const bool& storeAsFloat) {
+      this->mantissaBits = mantissaBits;
+      if (this->mantissaBits < 0) this->mantissaBits = -1;
+      this->storeAsFloat = storeAsFloat;
+      return true;
+   }
+
    /** Resize the output file.
     * @param newSize New size.
     * @return If true, output file was successfully resized.*/
@@ -306,19 +1478,112 @@ namespace vlsv {
       return false;
    }
 
+   /** Enable or disable statistics of arrays written after this call. If enabled, 
+    * minimum, maximum, and mean value of each vector component are calculated 
+    * from the data given to the Writer, i.e., before precision reduction or 
+    * compression, and stored in the footer as attributes 'min', 'max', and 'mean'. 
+    * Attribute 'count' is the number of values of each component included in the 
+    * statistics, NaN values are ignored. Each attribute contains one value per 
+    * vector component separated by spaces. Statistics are only stored for integer 
+    * and single or double precision floating point arrays that have at most 
+    * 16 vector components. Readers obtain the statistics with getArrayAttributes 
+    * without reading the array. This function must be called by all processes.
+    * @param enabled If true, statistics are calculated.*/
+   void Writer::setStatistics(const bool& enabled) {
+      statistics = enabled;
+   }
+
+   /** Set the number of data subfiles used for files opened after this call. In 
+    * subfiling mode processes are split into groups of consecutive ranks, and each 
+    * group writes the data of uncompressed arrays to its own subfile, see getSubfileName. 
+    * This avoids lock contention and stripe count limits of a single shared file 
+    * at large process counts. The VLSV file contains the header, footer, and for 
+    * each subfiled array a table of [offset,bytes] pairs of the array's segment in 
+    * each subfile, in place of the array data. Such arrays have the attribute 
+    * 'subfiles' in the footer, and the table is written at the offset given in the 
+    * footer. Array data is the concatenation of the segments in subfile order, thus 
+    * Reader and ParallelReader read subfiled arrays like any other array. Compressed 
+    * arrays and arrays written in batch mode are always written to the VLSV file, 
+    * and checksums are not calculated for subfiled arrays. This function must be 
+    * called by all processes before open.
+    * @param subfiles Number of subfiles, values less than two disable subfiling. The number 
+    * of subfiles is limited to the number of processes.*/
+   void Writer::setSubfiles(const int& subfiles) {
+      this->subfiles = subfiles;
+   }
+
    /** Start dry run mode. In this mode no file I/O is performed, but getBytesWritten() 
     * will return the correct file size on master process. This can be passed to setSize function.*/
    void Writer::startDryRun() {
       dryRunning = true;
    }
 
+   /** Test if an asynchronous array write has completed. This function does not block.
+    * @param requestID ID of the write, as returned by endMultiwriteAsync or writeArrayAsync.
+    * @param completed Variable in which the completion status of the write is written.
+    * @return If false, requestID was invalid or the write failed.*/
+   bool Writer::test(const uint64_t& requestID,bool& completed) {
+      completed = false;
+      if (requestID == 0 || requestID > asyncRequestCounter) return false;
+
+      // Writes that have already been completed are not in asyncRequests:
+      map<uint64_t,vector<MPI_Request> >::iterator it = asyncRequests.find(requestID);
+      if (it == asyncRequests.end()) {
+         completed = true;
+         return true;
+      }
+
+      bool success = true;
+      int flag = 1;
+      const double t_start = MPI_Wtime();
+      if (it->second.size() > 0) {
+         if (MPI_Testall(it->second.size(),&(it->second[0]),&flag,MPI_STATUSES_IGNORE) != MPI_SUCCESS) success = false;
+      }
+      writeTime += (MPI_Wtime() - t_start);
+
+      if (flag != 0 || success == false) {
+         asyncRequests.erase(it);
+         completed = true;
+      }
+      return success;
+   }
+
+   /** Wait until an asynchronous array write has completed. This function is not collective.
+    * @param requestID ID of the write, as returned by endMultiwriteAsync or writeArrayAsync.
+    * @return If true, the data was written successfully.*/
+   bool Writer::wait(const uint64_t& requestID) {
+      if (requestID == 0 || requestID > asyncRequestCounter) return false;
+      map<uint64_t,vector<MPI_Request> >::iterator it = asyncRequests.find(requestID);
+      if (it == asyncRequests.end()) return true;
+
+      bool success = true;
+      const double t_start = MPI_Wtime();
+      if (it->second.size() > 0) {
+         if (MPI_Waitall(it->second.size(),&(it->second[0]),MPI_STATUSES_IGNORE) != MPI_SUCCESS) success = false;
+      }
+      writeTime += (MPI_Wtime() - t_start);
+      asyncRequests.erase(it);
+      return success;
+   }
+
+   /** Wait until all pending asynchronous array writes have completed.
+    * @return If true, all data was written successfully.*/
+   bool Writer::waitAll() {
+      bool success = true;
+      while (asyncRequests.empty() == false) {
+         if (wait(asyncRequests.begin()->first) == false) success = false;
+      }
+      return success;
+   }
+
    /** Start file output in multi-write mode. In multi-write mode the array write 
     * is split into multiple chunks. Typically this is done when the data in memory 
     * is not stored in a contiguous array. The multi-write mode can also be used as 
     * a workaround to issues related to integer overflows, i.e., if one wants to write 
     * more than 2^32-1 bytes of data per process. The multi-write chunks are added 
     * by calling addMultiwriteUnit functions. The data 
-    * is not written to the file until endMultiwrite is called.
+    * is not written to the file until endMultiwrite is called. This function and 
+    * endMultiwrite must be called outside of OpenMP parallel regions, or by a single thread.
     * @param datatype String representation of the datatype, either 'int', 'uint', or 'float'.
     * @param arraySize Total number of array elements this process will write.
     * @param vectorSize Size of the data vector stored in array element, each process must use the same vectorSize.
@@ -327,18 +1592,93 @@ namespace vlsv {
     * @see addMultiwriteUnit
     * @see endMultiwrite.*/
    bool Writer::startMultiwrite(const string& datatype,const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize) {
-      // Check that all processes have made it this far without error(s):
       bool success = true;
       if (fileOpen == false) success = false;
       if (initialized == false) success = false;
-      if (checkSuccess(success,comm) == false) return false;
+      subfileArray = false;
+
+      // Double precision arrays narrowed to floats take half of the space in file:
+      myBytes = arraySize * vectorSize * dataSize;
+      if (batchMode == false && storeAsFloat == true && getVLSVDatatype(datatype) == datatype::FLOAT && dataSize == sizeof(double)) {
+         myBytes = arraySize * vectorSize * sizeof(float);
+      }
+      if (batchMode == true) {
+         // In batch mode offsets of all queued arrays are calculated in commitBatch:
+         if (success == false) {
+            batchFailed = true;
+            return false;
+         }
+      } else if (compressionMethod != compression::NONE) {
+         // Offsets of compressed arrays depend on the compressed sizes and 
+         // are calculated in endMultiwrite. Status is checked there as well:
+         if (success == false) return false;
+      } else if (subfileComm != MPI_COMM_NULL) {
+         // Each process' offset is calculated relative to the start of its group's 
+         // segment in the subfile. Offset and size of each group's segment are 
+         // merged into the same reduction that checks status and calculates array size:
+         int subfileRank;
+         MPI_Comm_rank(subfileComm,&subfileRank);
+         uint64_t myExscan = 0;
+         MPI_Exscan(&myBytes,&myExscan,1,MPI_Type<uint64_t>(),MPI_SUM,subfileComm);
+         if (subfileRank == 0) myExscan = 0;
+
+         const int N_subfiles = min(subfiles,N_processes);
+         subfileOffset = alignOffset(subfileOffset);
+         vector<uint64_t> myValues(2+2*N_subfiles,0);
+         vector<uint64_t> globalValues(myValues.size());
+         if (success == false) myValues[0] = 1;
+         myValues[1] = myBytes;
+         if (subfileRank == 0) myValues[2+2*subfileIndex] = subfileOffset;
+         myValues[3+2*subfileIndex] = myBytes;
+         MPI_Allreduce(&(myValues[0]),&(globalValues[0]),myValues.size(),MPI_Type<uint64_t>(),MPI_SUM,comm);
+
+         // Check that all processes have made it this far without error(s):
+         if (globalValues[0] > 0) return false;
+         subfileTable.assign(globalValues.begin()+2,globalValues.end());
+         myOffset        = myExscan;
+         totalBytes      = subfileTable.size()*sizeof(uint64_t);
+         totalArrayBytes = globalValues[1];
+         totalChunks     = 0;
+         subfileArray    = true;
+      } else {
+         // Calculate this process' offset relative to array start with a prefix sum 
+         // over the number of bytes written by every process. Status check of all 
+         // processes is merged into the same reduction that calculates the array size:
+         uint64_t myExscan = 0;
+         MPI_Exscan(&myBytes,&myExscan,1,MPI_Type<uint64_t>(),MPI_SUM,comm);
+         if (myrank == 0) myExscan = 0;
+
+         uint64_t myValues[2];
+         uint64_t globalValues[2];
+         myValues[0] = 0;
+         if (success == false) myValues[0] = 1;
+         myValues[1] = myBytes;
+         MPI_Allreduce(myValues,globalValues,2,MPI_Type<uint64_t>(),MPI_SUM,comm);
+
+         // Check that all processes have made it this far without error(s):
+         if (globalValues[0] > 0) return false;
+         myOffset        = myExscan;
+         totalBytes      = globalValues[1];
+         totalArrayBytes = totalBytes;
+         totalChunks     = 0;
+      }
 
-      // Clear per-thread storage:
-        {
-           vector<list<Multi_IO_Unit> > dummy(1);
-           multiwriteUnits.swap(dummy);
-        }
-      multiwriteOffsets[0] = numeric_limits<unsigned int>::max();
+      // Each thread that may call addMultiwriteUnit in the next parallel region has its own storage:
+      #ifdef _OPENMP
+         const size_t N_threads = max(omp_get_max_threads(),omp_get_num_threads());
+         if (multiwriteUnits.size() < N_threads) {
+            multiwriteOffsets.resize(N_threads);
+            multiwriteUnits.resize(N_threads);
+         }
+      #endif
+
+      // Clear per-thread storage, memory reserved for units is reused. Merged 
+      // units must not exceed the size of a single collective write:
+      for (size_t t=0; t<multiwriteUnits.size(); ++t) {
+         multiwriteUnits[t].clear();
+         multiwriteUnits[t].setMaxUnitBytes(getMaxBytesPerWrite());
+         multiwriteOffsets[t] = numeric_limits<unsigned int>::max();
+      }
 
       // Array datatype and byte size of each vector element are determined 
       // from the template parameter, other values are copied from parameters:
@@ -347,23 +1687,11 @@ namespace vlsv {
       this->arraySize  = arraySize;
       this->vectorSize = vectorSize;
       this->dataSize   = dataSize;
+      multiwriteFailed = false;
       multiwriteFinalized = false;
       N_multiwriteUnits = 0;
       endMultiwriteCounter = 0;
 
-      // Gather the number of bytes written by every process to MPI master process:
-      myBytes = arraySize * vectorSize * dataSize;
-      MPI_Gather(&myBytes,1,MPI_Type<uint64_t>(),bytesPerProcess,1,MPI_Type<uint64_t>(),masterRank,comm);
-
-      // MPI master process calculates an offset to the output file for all processes:
-      if (myrank == masterRank) {
-         offsets[0] = offset;
-         for (int i=1; i<N_processes; ++i) offsets[i] = offsets[i-1] + bytesPerProcess[i-1];
-      }
-   
-      // MPI master scatters offsets:
-      MPI_Scatter(offsets,1,MPI_Type<uint64_t>(),&offset,1,MPI_Type<uint64_t>(),masterRank,comm);
-
       multiwriteInitialized = true;
       return multiwriteInitialized;
    }
@@ -373,129 +1701,364 @@ namespace vlsv {
     * @param attribs Attributes for the XML tag.
     * @return If true, array was successfully written to file.*/
    bool Writer::endMultiwrite(const std::string& tagName,const std::map<std::string,std::string>& attribs) {
-      // Check that multiwrite mode has started successfully on all processes:
       bool success = true;
       if (initialized == false) success = false;
       if (multiwriteInitialized == false) success = false;
-      if (checkSuccess(success,comm) == false) {
+
+      // Append units added by other threads to the units of thread 0 in thread order, 
+      // i.e., the data of thread t is written after the data of threads 0,...,t-1:
+      for (size_t t=1; t<multiwriteUnits.size(); ++t) {
+         multiwriteUnits[0].append(multiwriteUnits[t]);
+         multiwriteUnits[t].clear();
+      }
+
+      // Units that a thread could not record, or that do not cover the data 
+      // declared in startMultiwrite, would leave a hole in the array:
+      if (multiwriteFailed == true) success = false;
+      if (multiwriteInitialized == true && multiwriteUnits[0].getBytes() != arraySize*vectorSize*dataSize) {
+         cerr << "ERROR in vlsv::Writer! Multi-write units contain " << multiwriteUnits[0].getBytes();
+         cerr << " bytes, " << arraySize*vectorSize*dataSize << " bytes were declared in startMultiwrite" << endl;
+         success = false;
+      }
+
+      // In batch mode the array is queued and written in commitBatch:
+      if (batchMode == true) {
          multiwriteInitialized = false;
-         return false;
+         batchArrays.push_back(BatchArray());
+         BatchArray& array = batchArrays.back();
+
+         // A failed array is queued without data, so that all processes queue the same 
+         // number of arrays and commitBatch fails on all of them:
+         if (success == false) {
+            array.myBytes = 0;
+            batchFailed = true;
+            return false;
+         }
+         array.tagName    = tagName;
+         array.attribs    = attribs;
+         array.dataType   = dataType;
+         array.vectorSize = vectorSize;
+         array.dataSize   = dataSize;
+         array.myBytes    = myBytes;
+         array.units.swap(multiwriteUnits[0]);
+         return true;
       }
-      
-      // Calculate how many collective MPI calls are needed to 
-      // write all the data to output file:
-      size_t outputBytesize    = 0;
-      size_t myCollectiveCalls = 0;
-      if (multiwriteUnits[0].size() > 0) myCollectiveCalls = 1;
 
-      vector<pair<list<Multi_IO_Unit>::iterator,list<Multi_IO_Unit>::iterator> > multiwriteList;
-      list<Multi_IO_Unit>::iterator first = multiwriteUnits[0].begin();
-      list<Multi_IO_Unit>::iterator last  = multiwriteUnits[0].begin();
-      for (list<Multi_IO_Unit>::iterator it=multiwriteUnits[0].begin(); it!=multiwriteUnits[0].end(); ++it) {
-         if (outputBytesize + (*it).amount*dataSize > getMaxBytesPerWrite()) {
-            multiwriteList.push_back(make_pair(first,last));
-            first = it; last = it;
+      // Combine statistics of the original data of all processes at master:
+      arrayStatistics.clear();
+      if (statistics == true && statisticsSupported(vlsvType,dataSize,vectorSize) == true) {
+         vector<double> myStatistics(4*vectorSize);
+         unitStatistics(multiwriteUnits[0],vlsvType,dataSize,vectorSize,&(myStatistics[0]));
+         arrayStatistics.resize(4*vectorSize);
+         if (reduceStatistics(&(myStatistics[0]),vectorSize,&(arrayStatistics[0]),masterRank,comm) == false) success = false;
+      }
+      
+      // Round floating point data and/or narrow it to single precision. Reduced data is 
+      // kept in a buffer that is reused by the next array, thus these arrays are always 
+      // written with blocking writes:
+      map<string,string> reducedAttribs;
+      const map<string,string>* footerAttribs = &attribs;
+      if (vlsvType == datatype::FLOAT && (dataSize == sizeof(float) || dataSize == sizeof(double))
+          && (mantissaBits >= 0 || (storeAsFloat == true && dataSize == sizeof(double)))) {
+         const uint64_t originalDataSize = dataSize;
+         asyncWrite = false;
+         if (success == true) {
+            if (reducePrecision() == false) success = false;
+         }
+         reducedAttribs = attribs;
+         if (mantissaBits >= 0) {
+            stringstream ss;
+            ss << min(mantissaBits,dataSize == sizeof(float) ? 23 : 52);
+            reducedAttribs["mantissabits"] = ss.str();
+         }
+         if (dataSize != originalDataSize) {
+            stringstream ss;
+            ss << originalDataSize;
+            reducedAttribs["originaldatasize"] = ss.str();
+         }
+         footerAttribs = &reducedAttribs;
+      }
 
-            outputBytesize = 0;
-            ++myCollectiveCalls;
+      // Arrays that are identical to an array in an earlier file are stored as 
+      // references to it. Compressed arrays and arrays written to subfiles are 
+      // always written. The reference is only valid if all processes match:
+      const bool deduplicate = (history != NULL && dryRunning == false 
+                                && compressionMethod == compression::NONE && subfileArray == false);
+      string historyKey;
+      uint64_t myHash = 0;
+      if (deduplicate == true) {
+         historyKey = getHistoryKey(tagName,*footerAttribs);
+         myHash = unitHash(multiwriteUnits[0]);
+         const bool found = findReference(historyKey,myHash,success);
+         if (success == false) {
+            multiwriteInitialized = false;
+            return false;
+         }
+         if (found == true) {
+            totalBytes = 0;
+            if (multiwriteFooter(tagName,*footerAttribs) == false) success = false;
+            referenceFile.clear();
+            multiwriteInitialized = false;
+            if (checkSuccess(success,comm) == false) return false;
+            return snapshotFooter();
          }
-         outputBytesize += (*it).amount*dataSize;
-         ++last;
       }
-      multiwriteList.push_back(make_pair(first,last));
 
-      size_t N_collectiveCalls;
-      MPI_Allreduce(&myCollectiveCalls,&N_collectiveCalls,1,MPI_Type<size_t>(),MPI_MAX,comm);
+      // Array data starts at an aligned offset, the gap after the previous array is left unwritten:
+      offset = alignOffset(offset);
+
+      // Compress this process' data and calculate file offsets from the compressed sizes. 
+      // Compressed data is kept in a buffer that is reused by the next array, thus 
+      // compressed arrays are always written with blocking writes:
+      MPI_Offset chunkTableOffset = 0;
+      if (compressionMethod != compression::NONE) {
+         asyncWrite = false;
+         if (success == true) {
+            if (compressMultiwriteUnits() == false) success = false;
+         }
 
-      if (N_collectiveCalls > multiwriteList.size()) {
-         const size_t N_dummyCalls = N_collectiveCalls-multiwriteList.size();
-         for (size_t i=0; i<N_dummyCalls; ++i) {
-            multiwriteList.push_back(make_pair(multiwriteUnits[0].end(),multiwriteUnits[0].end()));
+         uint64_t myValues[4];
+         uint64_t myExscan[2];
+         uint64_t globalValues[4];
+         myValues[0] = 0;
+         if (success == false) myValues[0] = 1;
+         myValues[1] = compressionBuffer.size();
+         myValues[2] = chunkTable.size()/2;
+         myValues[3] = myBytes;
+         myExscan[0] = 0;
+         myExscan[1] = 0;
+         MPI_Exscan(myValues+1,myExscan,2,MPI_Type<uint64_t>(),MPI_SUM,comm);
+         if (myrank == 0) {myExscan[0] = 0; myExscan[1] = 0;}
+         MPI_Allreduce(myValues,globalValues,4,MPI_Type<uint64_t>(),MPI_SUM,comm);
+         if (globalValues[0] > 0) {
+            multiwriteInitialized = false;
+            return false;
          }
+         myOffset        = myExscan[0];
+         myChunkOffset   = myExscan[1];
+         totalBytes      = globalValues[1];
+         totalChunks     = globalValues[2];
+         totalArrayBytes = globalValues[3];
+         chunkTableOffset = offset + totalBytes + myChunkOffset*2*sizeof(uint64_t);
       }
 
-      MPI_Offset unitOffset = 0;
-      for (size_t i=0; i<multiwriteList.size(); ++i) {
-         if (multiwriteFlush(i,unitOffset,multiwriteList[i].first,multiwriteList[i].second) == false) success = false;
-         for (std::list<Multi_IO_Unit>::iterator it=multiwriteList[i].first; it!=multiwriteList[i].second; ++it) {
-            unitOffset += it->amount*dataSize;
+      // Combine checksums of the data and chunk table pieces of all processes at master. 
+      // Checksums are not calculated for arrays written to subfiles:
+      if (checksums == true && subfileArray == false) {
+         uint64_t myChecksums[4];
+         uint64_t arrayChecksums[4];
+         unitChecksum(multiwriteUnits[0],myChecksums);
+         myChecksums[2] = 0;
+         myChecksums[3] = 0;
+         if (compressionMethod != compression::NONE && chunkTable.size() > 0) {
+            myChecksums[3] = chunkTable.size()*sizeof(uint64_t);
+            myChecksums[2] = crc32c(0,reinterpret_cast<char*>(&(chunkTable[0])),myChecksums[3]);
          }
+         if (reduceChecksums(myChecksums,2,arrayChecksums,masterRank,comm) == false) success = false;
+         if (myrank == masterRank) arrayChecksum = crc32cCombine(arrayChecksums[0],arrayChecksums[2],arrayChecksums[3]);
       }
 
-      if (multiwriteFooter(tagName,attribs) == false) success = false;
+      // Write data, and the chunk table of a compressed array:
+      const MPI_Offset dataOffset = (subfileArray == true) ? subfileOffset : offset;
+      if (writeMultiwriteUnits(multiwriteUnits[0],dataOffset+myOffset,success) == false) {
+         multiwriteInitialized = false;
+         subfileArray = false;
+         return false;
+      }
+
+      // Master writes the table of subfile segments to the VLSV file in place of array data:
+      if (subfileArray == true) {
+         if (myrank == masterRank && dryRunning == false) {
+            const double t_start = MPI_Wtime();
+            if (MPI_File_write_at(fileptr,offset,&(subfileTable[0]),subfileTable.size(),MPI_Type<uint64_t>(),MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+            writeTime += (MPI_Wtime() - t_start);
+         }
+         subfileOffset += subfileTable[2*subfileIndex+1];
+      }
+      if (totalChunks > 0) {
+         Multi_IO_Buffer chunkTableUnits;
+         if (chunkTable.size() > 0) {
+            chunkTableUnits.push_back(Multi_IO_Unit(reinterpret_cast<char*>(&(chunkTable[0])),MPI_Type<uint64_t>(),chunkTable.size()));
+         }
+         if (writeMultiwriteUnits(chunkTableUnits,chunkTableOffset,success) == false) {
+            multiwriteInitialized = false;
+            return false;
+         }
+      }
+
+      if (multiwriteFooter(tagName,*footerAttribs) == false) success = false;
       multiwriteInitialized = false;
+      subfileArray = false;
+
+      // Update global file offset:
+      const MPI_Offset arrayOffset = offset;
+      offset += totalBytes + totalChunks*2*sizeof(uint64_t);
       if (checkSuccess(success,comm) == false) return false;
-      return true;
+      if (deduplicate == true) recordArray(historyKey,arrayOffset,myHash);
+      return snapshotFooter();
+   }
+
+   /** Write multiwrite units to file asynchronously. This function works 
+    * like endMultiwrite, except that the collective file write(s) are only 
+    * started here and this function returns without waiting for them to complete.
+    * The XML footer entry of the array is inserted immediately. The memory 
+    * given to addMultiwriteUnit must not be modified or deallocated until the 
+    * write has been completed with Writer::wait, Writer::test, or Writer::waitAll.
+    * Writer::close waits for all pending writes before the footer is written.
+    * If the MPI library does not support nonblocking collective file I/O 
+    * (MPI 3.1 or newer is required) the data is written before this function returns.
+    * @param tagName Name of the XML tag for this array.
+    * @param attribs Attributes for the XML tag.
+    * @param requestID Variable in which the ID of the started write is written.
+    * @return If true, array write was started successfully.
+    * @see wait
+    * @see test
+    * @see waitAll.*/
+   bool Writer::endMultiwriteAsync(const std::string& tagName,const std::map<std::string,std::string>& attribs,uint64_t& requestID) {
+      ++asyncRequestCounter;
+      requestID = asyncRequestCounter;
+      asyncRequests[requestID];
+
+      asyncWrite = true;
+      const bool success = endMultiwrite(tagName,attribs);
+      asyncWrite = false;
+      return success;
    }
 
    /** Flush multi-write units to output file. This function does the actual file I/O.
     * @param counter Number of multi-write unit we are writing.
-    * @param unitOffset Output file offset relative to the starting position for this process.
+    * @param fileOffset Output file offset where the first multi-write unit is written.
     * @param start Iterator pointing to the first written multi-write unit.
     * @param stop Iterator pointing past the last written multi-write unit.
     * @return If true, this process succeeded in writing out the data.*/
-   bool Writer::multiwriteFlush(const size_t& counter,const MPI_Offset& unitOffset,
-                                std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& stop) {
+   bool Writer::multiwriteFlush(const size_t& counter,const MPI_Offset& fileOffset,
+                                Multi_IO_Buffer::iterator& start,Multi_IO_Buffer::iterator& stop) {
       bool success = true;
 
-      // Count the total number of multiwrite units:
-      N_multiwriteUnits = 0;
-      for (list<Multi_IO_Unit>::const_iterator it=start; it!=stop; ++it) {
-         ++N_multiwriteUnits;
-      }
+      // Number of multiwrite units in this flush and their total byte size:
+      N_multiwriteUnits = stop - start;
+      const uint64_t amount = getUnitBytes(start,stop);
 
-      // Allocate memory for an MPI_Struct that is used to 
-      // write all multiwrite units with a single collective call:
-      blockLengths  = new int[N_multiwriteUnits];
-      displacements = new MPI_Aint[N_multiwriteUnits];
-      types         = new MPI_Datatype[N_multiwriteUnits];
-
-      // Calculate a global offset pointer for MPI struct, i.e. an 
+      // Calculate a global offset pointer for MPI datatype, i.e. an 
       // offset which is used to calculate the displacements:
       multiwriteOffsetPointer = NULL;
-      if (multiwriteUnits[0].size() > 0) multiwriteOffsetPointer = start->array;
-
-      // Copy pointers etc. to MPI struct:
-      size_t i=0;
-      size_t amount = 0;
-      for (list<Multi_IO_Unit>::iterator it=start; it!=stop; ++it) {
-         blockLengths[i]  = (*it).amount;
-         displacements[i] = (*it).array - multiwriteOffsetPointer;
-         types[i]         = (*it).mpiType;
-
-         int datatypeBytesize;
-         MPI_Type_size(it->mpiType,&datatypeBytesize);
-         amount += (*it).amount * datatypeBytesize;
-         
-         ++i;
-      }
+      if (N_multiwriteUnits > 0) multiwriteOffsetPointer = start->array;
 
       // Write data to file:
       if (dryRunning == false) {
-         if (N_multiwriteUnits > 0) {
-            // Create an MPI struct containing the multiwrite units:
-            MPI_Datatype outputType;
-            MPI_Type_create_struct(N_multiwriteUnits,blockLengths,displacements,types,&outputType);
-            MPI_Type_commit(&outputType);
-
-            // Write data to output file with a single collective call:
-            const double t_start = MPI_Wtime();
-            MPI_File_write_at_all(fileptr,offset+unitOffset,multiwriteOffsetPointer,1,outputType,MPI_STATUS_IGNORE);
-            writeTime += (MPI_Wtime() - t_start);
-            MPI_Type_free(&outputType);
+         if (aggregationComm != MPI_COMM_NULL) {
+            // Node-level aggregation is always done with blocking writes:
+            if (aggregatedWrite(fileOffset,start,stop,amount) == false) success = false;
+         } else if (N_multiwriteUnits > 0) {
+            // Staging buffer is reused by the next flush, thus nonblocking writes are never packed:
+            const iostrategy::type strategy = selectIOStrategy(ioStrategy,start,stop,amount,asyncWrite == false);
+            if (strategy == iostrategy::PACK) {
+               if (stagingBuffer.size() < amount) stagingBuffer.resize(amount);
+               packUnits(start,stop,&(stagingBuffer[0]));
+               if (startWrite(fileOffset,&(stagingBuffer[0]),amount,MPI_BYTE) == false) success = false;
+            } else {
+               // Create an MPI datatype containing the multiwrite units. The arrays 
+               // used to create the datatype are reused by subsequent flushes:
+               MPI_Datatype outputType = createUnitDatatype(strategy,start,stop,blockLengths,displacements,types);
+
+               // Write data to output file with a single collective call. Datatype 
+               // can be freed immediately also if the write is nonblocking:
+               if (startWrite(fileOffset,multiwriteOffsetPointer,1,outputType) == false) success = false;
+               MPI_Type_free(&outputType);
+            }
          } else {
             // Process has no data to write but needs to participate in the collective call to prevent deadlock:
-            const double t_start = MPI_Wtime();
-            MPI_File_write_at_all(fileptr,offset+unitOffset,NULL,0,MPI_BYTE,MPI_STATUS_IGNORE);
-            writeTime += (MPI_Wtime() - t_start);
+            if (startWrite(fileOffset,NULL,0,MPI_BYTE) == false) success = false;
          }
       }
+      return success;
+   }
 
-      // Deallocate memory:
-      delete [] blockLengths; blockLengths = NULL;
-      delete [] displacements; displacements = NULL;
-      delete [] types; types = NULL;
+   /** Write a footer snapshot if footer snapshots are enabled and enough arrays have 
+    * been written after the previous snapshot, see setFooterInterval. The first snapshot 
+    * is the complete footer, later snapshots only contain the tags added after the 
+    * previous snapshot, see footersnapshot in vlsv_common.h. File data is synchronized 
+    * to storage before the header is updated to point to the snapshot, so that the 
+    * header never points to a footer of arrays that are not yet in the file. 
+    * This function must be called by all processes.
+    * @return If true, the snapshot was written successfully or it was not needed.*/
+   bool Writer::snapshotFooter() {
+      if (footerInterval == 0 || arraysSinceSnapshot < footerInterval) return true;
+      bool success = true;
+      if (waitAll() == false) success = false;
+      arraysSinceSnapshot = 0;
 
+      uint64_t bytesIndex = 0;
+      uint64_t bytesFooter = 0;
+      if (myrank == masterRank) {
+         if (snapshotOffset == 0) {
+            bytesIndex = writeFooterIndex(offset);
+            if (writeFooter(*xmlWriter,offset+bytesIndex,bytesFooter) == false) success = false;
+         } else {
+            // Later snapshots contain the new tags and a pointer to the previous snapshot:
+            muxml::MuXML snapshot;
+            muxml::XMLNode* vlsv = snapshot.addNode(snapshot.getRoot(),"VLSV","");
+            snapshot.addAttribute(vlsv,footersnapshot::PREVIOUS,snapshotOffset);
+            for (size_t t=0; t<snapshotTags.size(); ++t) {
+               muxml::XMLNode* node = snapshot.addNode(vlsv,snapshotTags[t].first,snapshotTags[t].second->value);
+               node->attributes = snapshotTags[t].second->attributes;
+            }
+            if (writeFooter(snapshot,offset,bytesFooter) == false) success = false;
+         }
+      }
+      if (dryRunning == false) {
+         if (MPI_File_sync(fileptr) != MPI_SUCCESS) success = false;
+         if (subfileComm != MPI_COMM_NULL) {
+            if (MPI_File_sync(subfilePtr) != MPI_SUCCESS) success = false;
+         }
+      }
+
+      // Header is not updated to point to a snapshot that was not written completely:
+      if (myrank == masterRank && success == true) {
+         uint64_t footerOffset = offset + bytesIndex;
+         char header[2*sizeof(uint64_t)];
+         setFooterIndexOffset(header,(bytesIndex > 0) ? offset : 0);
+         memcpy(header+sizeof(uint64_t),&footerOffset,sizeof(uint64_t));
+         if (dryRunning == false) {
+            if (MPI_File_write_at(fileptr,1,header+1,sizeof(header)-1,MPI_BYTE,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+         }
+
+         // Tags of a snapshot that the header does not point to are written again in the next snapshot:
+         if (success == true) {
+            snapshotOffset = footerOffset;
+            snapshotTags.clear();
+         }
+      }
+
+      // Snapshot is kept in the file, the next array is written after it:
+      bytesFooter += bytesIndex;
+      MPI_Bcast(&bytesFooter,1,MPI_Type<uint64_t>(),masterRank,comm);
+      offset += bytesFooter;
+      return checkSuccess(success,comm);
+   }
+
+   /** Start a collective write to the output file. If asynchronous write has been 
+    * requested the write is started with a nonblocking MPI call and the MPI request 
+    * is stored in asyncRequests, otherwise this function blocks until the data has been written.
+    * @param fileOffset Offset into output file where the data is written.
+    * @param buffer Pointer to the written data.
+    * @param count Number of written elements of type datatype.
+    * @param datatype MPI datatype of the written data.
+    * @return If true, the write was started (or completed) successfully.*/
+   bool Writer::startWrite(const MPI_Offset& fileOffset,char* buffer,const int& count,MPI_Datatype datatype) {
+      bool success = true;
+      const double t_start = MPI_Wtime();
+      #if MPI_VERSION > 3 || (MPI_VERSION == 3 && MPI_SUBVERSION >= 1)
+      if (asyncWrite == true) {
+         MPI_Request request;
+         if (MPI_File_iwrite_at_all(getDataFile(),fileOffset,buffer,count,datatype,&request) != MPI_SUCCESS) success = false;
+         else asyncRequests[asyncRequestCounter].push_back(request);
+         writeTime += (MPI_Wtime() - t_start);
+         return success;
+      }
+      #endif
+      if (MPI_File_write_at_all(getDataFile(),fileOffset,buffer,count,datatype,MPI_STATUS_IGNORE) != MPI_SUCCESS) success = false;
+      writeTime += (MPI_Wtime() - t_start);
       return success;
    }
 
@@ -506,50 +2069,258 @@ namespace vlsv {
     * @return If true, footer entry was inserted successfully.*/
    bool Writer::multiwriteFooter(const std::string& tagName,const std::map<std::string,std::string>& attribs) {
       bool success = true;
+      ++arraysSinceSnapshot;
+      if (layout != NULL) layoutOffsets.push_back(offset);
       if (myrank != masterRank) return true;
 
-      // Count total number of bytes written to file:
-      uint64_t totalBytes = 0;
-      for (int i=0; i<N_processes; ++i) totalBytes += bytesPerProcess[i];
-
       muxml::XMLNode* root = xmlWriter->getRoot();
       muxml::XMLNode* xmlnode = xmlWriter->find("VLSV",root);
-      muxml::XMLNode* node = xmlWriter->addNode(xmlnode,tagName,offset);
+      muxml::XMLNode* node = NULL;
+      if (referenceFile.empty() == true) node = xmlWriter->addNode(xmlnode,tagName,offset);
+      else {
+         node = xmlWriter->addNode(xmlnode,tagName,referenceOffset);
+         xmlWriter->addAttribute(node,"file",getReferenceName(fileName,referenceFile));
+      }
       for (map<string,string>::const_iterator it=attribs.begin(); it!=attribs.end(); ++it) {
          xmlWriter->addAttribute(node,it->first,it->second);
       }
       xmlWriter->addAttribute(node,"vectorsize",vectorSize);
-      xmlWriter->addAttribute(node,"arraysize",totalBytes/dataSize/vectorSize);
+      xmlWriter->addAttribute(node,"arraysize",totalArrayBytes/dataSize/vectorSize);
       xmlWriter->addAttribute(node,"datatype",dataType);
       xmlWriter->addAttribute(node,"datasize",dataSize);
+      if (totalChunks > 0) {
+         xmlWriter->addAttribute(node,"compression",getCompression(compressionMethod));
+         xmlWriter->addAttribute(node,"chunks",totalChunks);
+         xmlWriter->addAttribute(node,"chunkindex",offset+totalBytes);
+      }
+      if (subfileArray == true) {
+         xmlWriter->addAttribute(node,"subfiles",subfileTable.size()/2);
+         bytesWritten += totalArrayBytes;
+      } else if (checksums == true && referenceFile.empty() == true) {
+         xmlWriter->addAttribute(node,"crc32c",arrayChecksum);
+      }
 
-      // Update global file offset:
-      offset += totalBytes;
-      bytesWritten += totalBytes;
+      // Statistics are written as lists with one value per vector component:
+      if (arrayStatistics.size() == 4*vectorSize) {
+         stringstream minValues,maxValues,meanValues,counts;
+         minValues.precision(numeric_limits<double>::digits10+2);
+         maxValues.precision(numeric_limits<double>::digits10+2);
+         meanValues.precision(numeric_limits<double>::digits10+2);
+         for (uint64_t c=0; c<vectorSize; ++c) {
+            const char* separator = (c == 0) ? "" : " ";
+            const double count = arrayStatistics[4*c+3];
+            minValues  << separator << arrayStatistics[4*c+0];
+            maxValues  << separator << arrayStatistics[4*c+1];
+            meanValues << separator << ((count > 0.0) ? arrayStatistics[4*c+2]/count : 0.0);
+            counts     << separator << static_cast<uint64_t>(count);
+         }
+         xmlWriter->addAttribute(node,"min",minValues.str());
+         xmlWriter->addAttribute(node,"max",maxValues.str());
+         xmlWriter->addAttribute(node,"mean",meanValues.str());
+         xmlWriter->addAttribute(node,"count",counts.str());
+      }
+      if (footerInterval > 0) snapshotTags.push_back(make_pair(tagName,node));
+      bytesWritten += totalBytes + totalChunks*2*sizeof(uint64_t);
 
       return success;
    }
 
    bool Writer::writeArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
                            const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array) {
-      // Check that everything is OK before continuing:
+      // Status of all processes is checked in startMultiwrite and endMultiwrite, 
+      // a failure in addMultiwriteUnit makes endMultiwrite fail on all processes:
       bool success = true;
-      if (initialized == false) success = false;
-      if (fileOpen == false) success = false;
-      if (checkSuccess(success,comm) == false) return false;
-
       if (startMultiwrite(dataType,arraySize,vectorSize,dataSize) == false) {
          success = false; return success;
       }
 
       char* arrayPtr = const_cast<char*>(array);
-      if (addMultiwriteUnit(arrayPtr,arraySize) == false) success = false;
-      if (checkSuccess(success,comm) == false) {
-         return false;
-      }
+      if (addMultiwriteUnit(arrayPtr,arraySize) == false) multiwriteInitialized = false;
 
       if (endMultiwrite(arrayName,attribs) == false) success = false;
       return success;
    }
 
+   /** Start an asynchronous write of an array to the output file. This function 
+    * is simply a wrapper to multiwrite functions, i.e. array is written to file with 
+    * a single multiwrite unit, see Writer::endMultiwriteAsync. The contents of array 
+    * must not be modified before the write has completed.
+    * @return If true, array write was started successfully.
+    * @see wait
+    * @see test.*/
+   bool Writer::writeArrayAsync(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                                const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array,
+                                uint64_t& requestID) {
+      requestID = 0;
+      if (startMultiwrite(dataType,arraySize,vectorSize,dataSize) == false) return false;
+
+      char* arrayPtr = const_cast<char*>(array);
+      if (addMultiwriteUnit(arrayPtr,arraySize) == false) multiwriteInitialized = false;
+
+      return endMultiwriteAsync(arrayName,attribs,requestID);
+   }
+
+   /** Serialize the footer into a reusable buffer, and write it to the output file 
+    * in chunks while the footer is being serialized. Called by master process only.
+    * @param footerXml Footer that is written, the complete footer or a footer snapshot.
+    * @param footerOffset Offset into the output file where the footer is written.
+    * @param bytesFooter Number of bytes in the footer is written here.
+    * @return If true, the footer was written successfully.*/
+   bool Writer::writeFooter(const muxml::MuXML& footerXml,const MPI_Offset& footerOffset,uint64_t& bytesFooter) {
+      FooterWrite footer;
+      footer.dryRunning = dryRunning;
+      footer.fileptr    = fileptr;
+      footer.offset     = footerOffset;
+
+      const size_t chunkBytes = 4*1024*1024;
+      const double t_start = MPI_Wtime();
+      const bool success = footerXml.serialize(footerBuffer,chunkBytes,writeFooterChunk,&footer);
+      writeTime += (MPI_Wtime() - t_start);
+      bytesFooter = footer.offset - footerOffset;
+      bytesWritten += bytesFooter;
+      return success;
+   }
+
+   /** Build the binary footer index of the current footer and write it to the output 
+    * file, see footerindex in vlsv_common.h. The index is not written if it is disabled, 
+    * or if the footer has nested tags that the index cannot describe. Called by master 
+    * process only.
+    * @param indexOffset Offset into the output file where the index is written. 
+    * The footer is written immediately after the index.
+    * @return Number of bytes in the index, zero if the index was not written.*/
+   uint64_t Writer::writeFooterIndex(const MPI_Offset& indexOffset) {
+      if (footerIndex == false) return 0;
+      const muxml::XMLNode* root = xmlWriter->getRoot();
+      if (root->children.size() != 1 || root->children.begin()->first != "VLSV") return 0;
+      const muxml::XMLNode* vlsv = root->children.begin()->second;
+      if (vlsv->value.empty() == false || vlsv->attributes.empty() == false) return 0;
+
+      const double t_start = MPI_Wtime();
+      vector<uint64_t> tags;
+      vector<uint64_t> attributes;
+      string strings;
+      unordered_map<string,uint64_t> stringIds;
+      tags.reserve(vlsv->children.size()*footerindex::TAG_VALUES);
+      for (multimap<string,muxml::XMLNode*>::const_iterator it=vlsv->children.begin(); it!=vlsv->children.end(); ++it) {
+         const muxml::XMLNode* node = it->second;
+         if (node->children.empty() == false) return 0;
+         
+         uint64_t arraySize = 0;
+         uint64_t vectorSize = 0;
+         uint64_t dataSize = 0;
+         uint64_t dataType = 0;
+         tags.push_back(getFooterIndexString(it->first,strings,stringIds));
+         tags.push_back(getFooterIndexString(node->value,strings,stringIds));
+         tags.push_back(attributes.size() / footerindex::ATTRIBUTE_VALUES);
+         tags.push_back(node->attributes.size());
+         for (map<string,string>::const_iterator a=node->attributes.begin(); a!=node->attributes.end(); ++a) {
+            attributes.push_back(getFooterIndexString(a->first,strings,stringIds));
+            attributes.push_back(getFooterIndexString(a->second,strings,stringIds));
+            if (a->first == "arraysize") arraySize = strtoull(a->second.c_str(),NULL,10);
+            else if (a->first == "vectorsize") vectorSize = strtoull(a->second.c_str(),NULL,10);
+            else if (a->first == "datasize") dataSize = strtoull(a->second.c_str(),NULL,10);
+            else if (a->first == "datatype") {
+               if (a->second == "unknown") dataType = 1 + datatype::UNKNOWN;
+               else if (a->second == "int") dataType = 1 + datatype::INT;
+               else if (a->second == "uint") dataType = 1 + datatype::UINT;
+               else if (a->second == "float") dataType = 1 + datatype::FLOAT;
+            }
+         }
+         tags.push_back(strtoull(node->value.c_str(),NULL,10));
+         tags.push_back(arraySize);
+         tags.push_back(vectorSize);
+         tags.push_back(dataSize);
+         tags.push_back(dataType);
+      }
+
+      // Index is assembled into the footer buffer, it is serialized after the index has been written:
+      const size_t magicBytes = strlen(footerindex::MAGIC);
+      const uint64_t bytesIndex = footerindex::HEADER_BYTES + (tags.size() + attributes.size())*sizeof(uint64_t) + strings.size();
+      const uint64_t header[4] = {indexOffset+bytesIndex,tags.size()/footerindex::TAG_VALUES,
+                                  attributes.size()/footerindex::ATTRIBUTE_VALUES,strings.size()};
+      footerBuffer.resize(bytesIndex);
+      char* ptr = &(footerBuffer[0]);
+      memcpy(ptr,footerindex::MAGIC,magicBytes);
+      memcpy(ptr+magicBytes,header,sizeof(header));
+      ptr += footerindex::HEADER_BYTES;
+      if (tags.empty() == false) memcpy(ptr,&(tags[0]),tags.size()*sizeof(uint64_t));
+      ptr += tags.size()*sizeof(uint64_t);
+      if (attributes.empty() == false) memcpy(ptr,&(attributes[0]),attributes.size()*sizeof(uint64_t));
+      ptr += attributes.size()*sizeof(uint64_t);
+      memcpy(ptr,strings.data(),strings.size());
+
+      if (dryRunning == false) {
+         MPI_Status status;
+         int count = 0;
+         if (MPI_File_write_at(fileptr,indexOffset,&(footerBuffer[0]),bytesIndex,MPI_BYTE,&status) != MPI_SUCCESS) return 0;
+         if (MPI_Get_count(&status,MPI_BYTE,&count) != MPI_SUCCESS || static_cast<uint64_t>(count) != bytesIndex) return 0;
+      }
+      writeTime += (MPI_Wtime() - t_start);
+      bytesWritten += bytesIndex;
+      return bytesIndex;
+   }
+
+   /** Write a list of multi-write units to the output file. The units are split 
+    * into as many collective calls as needed to keep each call below getMaxBytesPerWrite() 
+    * bytes. Status of all processes is checked in the same reduction that calculates 
+    * the number of collective calls. This function must be called by all processes.
+    * @param units Written multi-write units.
+    * @param fileOffset Output file offset where this process' data is written.
+    * @param success Status of this process. Set to false if this process fails to write its data.
+    * @return If false, some process had failed before the write and no data was written.*/
+   bool Writer::writeMultiwriteUnits(Multi_IO_Buffer& units,const MPI_Offset& fileOffset,bool& success) {
+      // Calculate how many collective MPI calls are needed to 
+      // write all the data to output file:
+      size_t outputBytesize    = 0;
+      size_t myCollectiveCalls = 0;
+      if (units.size() > 0) myCollectiveCalls = 1;
+
+      vector<pair<Multi_IO_Buffer::iterator,Multi_IO_Buffer::iterator> > multiwriteList;
+      Multi_IO_Buffer::iterator first = units.begin();
+      Multi_IO_Buffer::iterator last  = units.begin();
+      for (Multi_IO_Buffer::iterator it=units.begin(); it!=units.end(); ++it) {
+         int datatypeBytesize;
+         MPI_Type_size(it->mpiType,&datatypeBytesize);
+         if (outputBytesize + it->amount*datatypeBytesize > getMaxBytesPerWrite()) {
+            multiwriteList.push_back(make_pair(first,last));
+            first = it; last = it;
+
+            outputBytesize = 0;
+            ++myCollectiveCalls;
+         }
+         outputBytesize += it->amount*datatypeBytesize;
+         ++last;
+      }
+      multiwriteList.push_back(make_pair(first,last));
+
+      // Reduce the maximum number of collective calls to all processes. Check that 
+      // all processes have made it this far without errors in the same reduction:
+      uint64_t myValues[2];
+      uint64_t globalValues[2];
+      myValues[0] = 0;
+      if (success == false) myValues[0] = 1;
+      myValues[1] = myCollectiveCalls;
+      MPI_Allreduce(myValues,globalValues,2,MPI_Type<uint64_t>(),MPI_MAX,comm);
+      if (globalValues[0] > 0) return false;
+      const size_t N_collectiveCalls = globalValues[1];
+
+      if (N_collectiveCalls > multiwriteList.size()) {
+         const size_t N_dummyCalls = N_collectiveCalls-multiwriteList.size();
+         for (size_t i=0; i<N_dummyCalls; ++i) {
+            multiwriteList.push_back(make_pair(units.end(),units.end()));
+         }
+      }
+
+      MPI_Offset unitOffset = fileOffset;
+      for (size_t i=0; i<multiwriteList.size(); ++i) {
+         if (multiwriteFlush(i,unitOffset,multiwriteList[i].first,multiwriteList[i].second) == false) success = false;
+         for (Multi_IO_Buffer::iterator it=multiwriteList[i].first; it!=multiwriteList[i].second; ++it) {
+            int datatypeBytesize;
+            MPI_Type_size(it->mpiType,&datatypeBytesize);
+            unitOffset += it->amount*datatypeBytesize;
+         }
+      }
+      return true;
+   }
+
 } // namespace vlsv
@@ -22,6 +22,12 @@
 #include <stdint.h>
 #include <mpi.h>
 #include <limits>
+#include <map>
+#include <vector>
+
+#ifdef _OPENMP
+   #include <omp.h>
+#endif
 
 #include "muxml.h"
 #include "mpiconversion.h"
@@ -52,24 +58,102 @@
 namespace vlsv {
 
    bool checkSuccess(const bool& myStatus,MPI_Comm comm);
+
+   /** Byte layout of a VLSV file, i.e., file offsets of all arrays and the total 
+    * file size including the footer, recorded by Writer. See Writer::setLayout.*/
+   class WriteLayout {
+    public:
+      WriteLayout();
+
+      void clear();
+      const std::vector<uint64_t>& getArrayOffsets() const;
+      uint64_t getFileSize() const;
+      bool wasReused() const;
+
+    private:
+      friend class Writer;
+
+      std::vector<uint64_t> arrayOffsets; /**< File offset of each array in the order the arrays were written.*/
+      uint64_t fileSize;                  /**< Size of the file in bytes, zero if no layout has been recorded.*/
+      bool reused;                        /**< If true, the most recently written file had the same layout 
+                                           * as the file before it.*/
+   };
    
+   /** Arrays written to earlier VLSV files by Writer. An array that is identical to 
+    * an array in an earlier file is stored as a reference to that file instead 
+    * of writing its data again. See Writer::setHistory.*/
+   class WriteHistory {
+    public:
+      WriteHistory();
+
+      void clear();
+      uint64_t getReferencedArrays() const;
+      uint64_t getReferencedBytes() const;
+
+    private:
+      friend class Writer;
+
+      /** Array whose data is stored in a file. Each process records its own part of the array.*/
+      struct Array {
+         std::string fileName;          /**< Name of the file in which the array data is stored.*/
+         uint64_t offset;               /**< File offset of the array.*/
+         std::string dataType;          /**< String representation of the datatype.*/
+         uint64_t vectorSize;           /**< Size of the data vector in each array element.*/
+         uint64_t dataSize;             /**< Byte size of the primitive datatype.*/
+         uint64_t totalBytes;           /**< Number of bytes in the array.*/
+         uint64_t myOffset;             /**< Offset of this process' data relative to the start of the array.*/
+         uint64_t myBytes;              /**< Number of bytes this process wrote to the array.*/
+         uint64_t myHash;               /**< Hash of the data this process wrote to the array, see hash64.*/
+      };
+
+      std::map<std::string,Array> arrays; /**< Arrays written so far, indexed by tag name and attributes.*/
+      uint64_t referencedArrays;          /**< Number of arrays stored as references in the most recently written file.*/
+      uint64_t referencedBytes;           /**< Number of array bytes not written to the most recently written file.*/
+   };
+
    class Writer {
     public:
       Writer();
       ~Writer();
 
+      /** Value for setAlignment that aligns arrays to the striping unit of the output file.*/
+      static const uint64_t STRIPE_ALIGNMENT = 0xFFFFFFFFFFFFFFFFULL;
+
       bool addMultiwriteUnit(char* array,const uint64_t& arrayElements);
+      bool beginBatch();
       bool close();
+      bool commitBatch();
       uint64_t getBytesWritten() const;
       double getWriteTime() const;
       void endDryRunning();
       bool endMultiwrite(const std::string& tagName,const std::map<std::string,std::string>& attribs);
-      bool open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo=MPI_INFO_NULL);
+      bool endMultiwriteAsync(const std::string& tagName,const std::map<std::string,std::string>& attribs,uint64_t& requestID);
+      bool open(const std::string& fname,MPI_Comm comm,const int& masterProcessID,MPI_Info mpiInfo=MPI_INFO_NULL,
+                const bool& append=false);
+      void setAlignment(const uint64_t& bytes);
+      void setChecksums(const bool& enabled);
+      bool setCompression(const compression::type& method,const uint64_t& chunkBytes=1048576);
+      void setFooterIndex(const bool& enabled);
+      void setFooterInterval(const uint64_t& arrays);
+      void setHintCache(const std::string& fileName);
+      void setHistory(WriteHistory* history);
+      void setIOStrategy(const iostrategy::type& strategy);
+      void setLayout(WriteLayout* layout,const bool& preallocate=false);
+      void setNodeAggregation(const int& aggregatorsPerNode);
+      bool setPrecision(const int& mantissaBits,const bool& storeAsFloat=false);
       bool setSize(MPI_Offset newSize);
+      void setStatistics(const bool& enabled);
+      void setSubfiles(const int& subfiles);
       void startDryRun();
       bool startMultiwrite(const std::string& datatype,const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize);      
+      bool test(const uint64_t& requestID,bool& completed);
+      bool wait(const uint64_t& requestID);
+      bool waitAll();
       bool writeArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
 		      const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array);
+      bool writeArrayAsync(const std::string& arrayName,const std::map<std::string,std::string>& attribs,const std::string& dataType,
+                           const uint64_t& arraySize,const uint64_t& vectorSize,const uint64_t& dataSize,const char* array,
+                           uint64_t& requestID);
    
       // ***** TEMPLATE WRAPPER FUNCTIONS ***** //
 
@@ -82,34 +166,100 @@ namespace vlsv {
       template<typename T> 
       bool writeArray(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
 		      const uint64_t& arraySize,const uint64_t& vectorSize,const T* array);
+
+      template<typename T>
+      bool writeArrayAsync(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
+                           const uint64_t& arraySize,const uint64_t& vectorSize,const T* array,uint64_t& requestID);
       
       template<typename T>
       bool writeParameter(const std::string& parameterName,const T* const array);
       
+      template<typename T>
+      bool writeWithDistributedReduction(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
+                                         const uint64_t& arraySize,T* array,MPI_Op operation);
       template<typename T>
       bool writeWithReduction(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
 			      const uint64_t& arraySize,T* array,MPI_Op operation);
    
     private:
 
+      /** Array queued for writing in batch mode.*/
+      struct BatchArray {
+         std::string tagName;                   /**< Name of the XML tag for this array.*/
+         std::map<std::string,std::string> attribs; /**< Attributes for the XML tag.*/
+         std::string dataType;                  /**< String representation of the datatype.*/
+         uint64_t vectorSize;                   /**< Size of the data vector in each array element.*/
+         uint64_t dataSize;                     /**< Byte size of the primitive datatype.*/
+         uint64_t myBytes;                      /**< Number of bytes this process writes to the array.*/
+         Multi_IO_Buffer units;                 /**< Multi-write units of this process.*/
+      };
+
+      MPI_Comm aggregationComm;               /**< Communicator containing the processes whose data is written 
+                                               * by the same aggregator process, MPI_COMM_NULL if node-level 
+                                               * aggregation is not used. Aggregator has rank 0.*/
+      std::vector<char> aggregationBuffer;    /**< Buffer used to pack and gather data in node-level aggregation.*/
+      int aggregatorsPerNode;                 /**< Number of aggregator processes per shared memory node, 
+                                               * zero value disables node-level aggregation.*/
+      uint64_t alignment;                     /**< Arrays start at file offsets that are multiples of this value, 
+                                               * resolved from alignmentRequest in open.*/
+      uint64_t alignmentRequest;              /**< Alignment given to setAlignment, zero disables alignment.*/
+      uint32_t arrayChecksum;                 /**< CRC32C checksum of the current array, significant at master process only.*/
       uint64_t arraySize;                     /**< Number of array elements this process will write.*/
-      int* blockLengths;                      /**< Used in creation of an MPI_Struct in endMultiwrite.*/
-      uint64_t* bytesPerProcess;              /**< Array with N_processes elements. Used to gather myBytes.*/
+      std::vector<double> arrayStatistics;    /**< Statistics of each vector component of the current array as 
+                                               * [min,max,sum,count] tuples, significant at master process only.*/
+      uint64_t arraysSinceSnapshot;           /**< Number of arrays written after the most recent footer snapshot.*/
+      uint64_t asyncRequestCounter;           /**< ID of the most recently started asynchronous array write.*/
+      std::map<uint64_t,std::vector<MPI_Request> > asyncRequests; /**< Pending MPI requests of each unfinished
+                                                                   * asynchronous array write, indexed by request ID.*/
+      bool asyncWrite;                        /**< If true, multiwriteFlush starts nonblocking collective writes 
+                                               * instead of blocking ones, see endMultiwriteAsync.*/
+      std::vector<BatchArray> batchArrays;    /**< Arrays queued for writing in commitBatch.*/
+      bool batchFailed;                       /**< If true, queueing an array has failed on this process.*/
+      bool batchMode;                         /**< If true, arrays are queued until commitBatch is called.*/
+      std::vector<int> blockLengths;          /**< Used in creation of an MPI datatype in multiwriteFlush, 
+                                               * reused across flushes.*/
       uint64_t bytesWritten;                  /**< Total amount of bytes written to output file,
                                                * significant at master process only.*/
+      bool checksums;                         /**< If true, a CRC32C checksum of each array is stored in the footer.*/
+      std::vector<uint64_t> chunkTable;       /**< Number of array elements and stored bytes in each compressed 
+                                               * chunk of this process, see vlsv_compression.h.*/
       MPI_Comm comm;                          /**< MPI communicator used in I/O.*/
+      std::vector<char> compressionBuffer;    /**< Buffer in which this process' compressed chunks are stored.*/
+      uint64_t compressionChunkBytes;         /**< Approximate number of uncompressed bytes in each compressed chunk.*/
+      std::vector<char> compressionInput;     /**< Buffer in which multi-write units are packed before compression.*/
+      compression::type compressionMethod;    /**< Compression method used for arrays, compression::NONE if 
+                                               * arrays are written uncompressed.*/
+      std::vector<char> compressionWorkspace; /**< Temporary buffer used in byte shuffle.*/
       uint64_t dataSize;                      /**< Byte size of each element in data vector, must have
                                                * the same value on all participating processes.*/
       std::string dataType;                   /**< String description of the datatype that is written to file,
                                                * obtained by calling arrayDataType() template function.*/
-      MPI_Aint* displacements;                /**< Used in creation of an MPI_Struct in endMultiwrite.*/
+      std::vector<MPI_Aint> displacements;    /**< Used in creation of an MPI datatype in multiwriteFlush, 
+                                               * reused across flushes.*/
       bool dryRunning;                        /**< If true, then dry run mode is enabled and all file I/O is skipped.*/
       unsigned int endMultiwriteCounter;      /**< A counter used in endMultiwrite to synchronize threads.*/
       std::string fileName;                   /**< Name of the output file.*/
       bool fileOpen;                          /**< If true, a file has been successfully opened for writing.*/
       MPI_File fileptr;                       /**< MPI file pointer to the output file.*/
+      std::vector<char> footerBuffer;         /**< Reusable buffer in which the footer is serialized in writeFooter, 
+                                               * and the footer index is assembled in writeFooterIndex.*/
+      bool footerIndex;                       /**< If true, a binary footer index is written before the footer, see setFooterIndex.*/
+      uint64_t footerInterval;                /**< Number of arrays between footer snapshots, zero disables snapshots.*/
+      std::string hintCache;                  /**< Name of the hint cache file, empty if not used, see setHintCache.*/
+      MPI_Info hintInfo;                      /**< MPI info containing the user's hints and the cached hints 
+                                               * used for the open file, MPI_INFO_NULL if not used.*/
+      WriteHistory* history;                  /**< Arrays written to earlier files, used to store identical arrays 
+                                               * as references. NULL if not used.*/
       bool initialized;                       /**< If true, VLSV Writer initialization is complete, does not tell if it was successful.*/
+      iostrategy::type ioStrategy;            /**< Method used to transfer multi-write units to MPI, see selectIOStrategy.*/
+      WriteLayout* layout;                    /**< Layout of the previous file, used to preallocate the output file, and 
+                                               * replaced by the layout of the output file in close. NULL if not used.*/
+      std::vector<uint64_t> layoutOffsets;    /**< File offsets of the arrays written to the output file so far.*/
+      int mantissaBits;                       /**< Number of mantissa bits kept in floating point arrays, 
+                                               * negative value disables rounding.*/
       int masterRank;                         /**< Rank of master process in communicator comm.*/
+      bool multiwriteFailed;                  /**< If true, a thread could not record a multi-write unit of the current 
+                                               * array, and endMultiwrite fails, see getThreadUnits.*/
       bool multiwriteFinalized;               /**< If true, multiwrite array writing mode has finalized correctly. 
                                                * This variable is used to synchronize threads in endMultiwrite function..*/
       bool multiwriteInitialized;             /**< If true, multiwrite array writing mode has initialized correctly. 
@@ -119,18 +269,50 @@ namespace vlsv {
                                                     * data into an MPI struct in endMultiwrite.*/
       char* multiwriteOffsetPointer;          /**< Pointer to an array that is used to calculate offsets in an 
                                                * MPI struct created in endMultiwrite.*/
-      std::vector<std::list<Multi_IO_Unit> > multiwriteUnits; /**< Container for all multiwrite units for this process. 
-                                                               * Each thread using VLSVWriter has its own list. This 
-                                                               * allows vlsv::Writer::addMultiwriteUnit to be called without 
-                                                               * thread synchronizations.*/   
+      std::vector<Multi_IO_Buffer> multiwriteUnits; /**< Container for all multiwrite units for this process. 
+                                                     * Each thread using VLSVWriter has its own buffer. This 
+                                                     * allows vlsv::Writer::addMultiwriteUnit to be called without 
+                                                     * thread synchronizations.*/   
       uint64_t myBytes;                       /**< Number of bytes this process is writing to the current array.*/
+      uint64_t myChunkOffset;                 /**< Number of compressed chunks written by processes with a lower rank.*/
+      MPI_Offset myOffset;                    /**< Offset of this process' data relative to the start of the current array.*/
       int myrank;                             /**< Rank of this process in communicator comm.*/
       unsigned int N_multiwriteUnits;         /**< Total number of multiwrite units this process has. In multithreaded mode 
                                                * this is equal to the sum of multiwrite units over all threads.*/
       int N_processes;                        /**< Number of processes in communicator comm.*/
-      MPI_Offset offset;                      /**< MPI offset into output file for this process.*/
-      MPI_Offset* offsets;                    /**< Array with N_processes elements. Used to scatter file offsets.*/
-      MPI_Datatype* types;                    /**< Used in creation of an MPI_Struct in endMultiwrite.*/
+      MPI_Offset offset;                      /**< Offset into output file where the current array starts, or where 
+                                               * the next array will start. Has the same value on all processes.*/
+      bool preallocate;                       /**< If true, file blocks are reserved with MPI_File_preallocate 
+                                               * instead of only setting the file size, see setLayout.*/
+      MPI_Offset preallocatedBytes;           /**< Size of the output file set in open, or the size of an appended file, 
+                                               * zero if the size was not set.*/
+      std::vector<char> precisionBuffer;      /**< Buffer in which data is packed when its precision is reduced.*/
+      std::string referenceFile;              /**< Name of the file containing the data of the current array if 
+                                               * the array is stored as a reference, otherwise empty.*/
+      uint64_t referenceOffset;               /**< File offset of the referenced array.*/
+      uint64_t snapshotOffset;                /**< Offset of the XML footer of the most recent footer snapshot, zero if 
+                                               * no snapshot has been written to the current file, see snapshotFooter.*/
+      std::vector<std::pair<std::string,muxml::XMLNode*> > snapshotTags; /**< Footer tags added after the most recent 
+                                                                          * footer snapshot, significant at master process only.*/
+      std::vector<char> stagingBuffer;        /**< Buffer in which fragmented multi-write units are packed, 
+                                               * reused across flushes.*/
+      bool statistics;                        /**< If true, statistics of each array are stored in the footer.*/
+      bool storeAsFloat;                      /**< If true, double precision arrays are stored as floats.*/
+      bool subfileArray;                      /**< If true, data of the current array is written to subfiles.*/
+      MPI_Comm subfileComm;                   /**< Communicator containing the processes that write the same subfile, 
+                                               * MPI_COMM_NULL if subfiling is not used.*/
+      int subfileIndex;                       /**< Index of the subfile written by this process.*/
+      MPI_Offset subfileOffset;               /**< Offset into this process' subfile where the next array starts.*/
+      MPI_File subfilePtr;                    /**< MPI file pointer to the subfile written by this process.*/
+      int subfiles;                           /**< Number of data subfiles, values less than two disable subfiling.*/
+      std::vector<uint64_t> subfileTable;     /**< Offset and size of the current array's segment in each subfile.*/
+      uint64_t totalArrayBytes;               /**< Uncompressed size of the current array in bytes.*/
+      uint64_t totalBytes;                    /**< Number of bytes all processes are writing to the current array. 
+                                               * For compressed arrays this is the total size of compressed chunks.*/
+      uint64_t totalChunks;                   /**< Number of compressed chunks in the current array, zero if 
+                                               * the array is written uncompressed.*/
+      std::vector<MPI_Datatype> types;        /**< Used in creation of an MPI datatype in multiwriteFlush, 
+                                               * reused across flushes.*/
       uint64_t vectorSize;                    /**< Number of elements in each data vector per array element,
                                                * must have the same value on all participating processes.*/
       datatype::type vlsvType;                /**< Same as dataType but in an integer representation.*/
@@ -138,8 +320,24 @@ namespace vlsv {
                                                * The timer on master process includes the time to write the header and footer.*/
       muxml::MuXML* xmlWriter;                /**< Pointer to XML writer, used for writing a footer to the VLSV file.*/
 
-      bool multiwriteFlush(const size_t& counter,const MPI_Offset& currentOffset,std::list<Multi_IO_Unit>::iterator& start,std::list<Multi_IO_Unit>::iterator& end);
+      bool aggregatedWrite(const MPI_Offset& fileOffset,Multi_IO_Buffer::iterator& start,
+                           Multi_IO_Buffer::iterator& stop,const uint64_t& bytes);
+      MPI_Offset alignOffset(const MPI_Offset& fileOffset) const;
+      bool compressMultiwriteUnits();
+      bool findReference(const std::string& key,const uint64_t& myHash,bool& success);
+      MPI_File getDataFile() const;
+      int getThreadIndex() const;
+      Multi_IO_Buffer* getThreadUnits();
+      bool multiwriteFlush(const size_t& counter,const MPI_Offset& fileOffset,Multi_IO_Buffer::iterator& start,Multi_IO_Buffer::iterator& end);
       bool multiwriteFooter(const std::string& tagName,const std::map<std::string,std::string>& attribs);
+      bool readFooter(const std::string& fname,uint64_t& footerOffset);
+      void recordArray(const std::string& key,const MPI_Offset& arrayOffset,const uint64_t& myHash);
+      bool reducePrecision();
+      bool snapshotFooter();
+      bool startWrite(const MPI_Offset& fileOffset,char* buffer,const int& count,MPI_Datatype datatype);
+      bool writeFooter(const muxml::MuXML& footerXml,const MPI_Offset& footerOffset,uint64_t& bytesFooter);
+      uint64_t writeFooterIndex(const MPI_Offset& indexOffset);
+      bool writeMultiwriteUnits(Multi_IO_Buffer& units,const MPI_Offset& fileOffset,bool& success);
    };
 
    template<typename T> inline
@@ -152,10 +350,27 @@ namespace vlsv {
    
       // Each thread records their multiwrite units to per-thread storage,
       // so there is no need to synchronize access to vector multiwriteUnits:
-      multiwriteUnits[0].push_back(Multi_IO_Unit(reinterpret_cast<char*>(arrayPtr),MPI_Type<T>(),arrayElements*vectorSize));
+      Multi_IO_Buffer* units = getThreadUnits();
+      if (units == NULL) return false;
+      units->push_back(Multi_IO_Unit(reinterpret_cast<char*>(arrayPtr),MPI_Type<T>(),arrayElements*vectorSize));
       return true;
    }
 
+   /** Round the given file offset up to the next array start, see setAlignment.
+    * @param fileOffset File offset.
+    * @return Smallest aligned offset that is not less than fileOffset.*/
+   inline MPI_Offset Writer::alignOffset(const MPI_Offset& fileOffset) const {
+      if (alignment <= 1) return fileOffset;
+      return ((fileOffset + alignment - 1) / alignment) * alignment;
+   }
+
+   /** Get the file in which the data of the current array is written.
+    * @return Subfile of this process if the array is written to subfiles, otherwise the output file.*/
+   inline MPI_File Writer::getDataFile() const {
+      if (subfileArray == true) return subfilePtr;
+      return fileptr;
+   }
+
    /** Start an array writing process.
     * @param arraySize  Number of elements this MPI process will write to the output array. 
     * @param vectorSize Number of elements in each data vector, this value must have the 
@@ -183,6 +398,24 @@ namespace vlsv {
       return writeArray(tagName,attribs,getStringDatatype<T>(),arraySize,vectorSize,sizeof(T),reinterpret_cast<char*>(arrayPtr));
    }
 
+   /** Start an asynchronous write of an array to the output file. This function 
+    * is simply a wrapper to multiwrite functions, see Writer::endMultiwriteAsync.
+    * The contents of array must not be modified before the write has completed.
+    * @param tagName Name of the array, same as the XML tag name in output file.
+    * @param attribs Other attributes for the output XML tag, given in [tag name,tag value] pairs.
+    * @param arraySize Number of elements in array.
+    * @param vectorSize Number of elements in vectors that comprise the array elements.
+    * @param array Pointer to the output array.
+    * @param requestID Variable in which the ID of the started write is written.
+    * @return If true, the array write was started successfully.*/
+   template<typename T> inline
+   bool Writer::writeArrayAsync(const std::string& tagName,const std::map<std::string,std::string>& attribs,
+                                const uint64_t& arraySize,const uint64_t& vectorSize,const T* array,uint64_t& requestID) {
+      T* arrayPtr = const_cast<T*>(array);
+      return writeArrayAsync(tagName,attribs,getStringDatatype<T>(),arraySize,vectorSize,sizeof(T),
+                             reinterpret_cast<char*>(arrayPtr),requestID);
+   }
+
    template<typename T> inline
    bool Writer::writeParameter(const std::string& parameterName,const T* const array) {
       std::map<std::string,std::string> attributes;
@@ -194,9 +427,53 @@ namespace vlsv {
         return writeArray("PARAMETER",attributes,0,0,array);
    }
 
+   /** Reduce an array over all processes and write the result. This works like 
+    * writeWithReduction, except that the result is not collected to master process. 
+    * The array is reduced with MPI_Reduce_scatter so that each process receives a 
+    * contiguous slice of the result, and the slices are written collectively. Memory 
+    * use and I/O bandwidth thus scale with the number of processes. The result is 
+    * stored as arraySize elements with vector size one, i.e., the bytes in the file are 
+    * the same as written by writeWithReduction but the array has a different shape 
+    * in the footer. This function must be called by all processes, outside batch mode.
+    * @param arrayName Name of the XML tag for this array.
+    * @param attribs Attributes for the XML tag.
+    * @param arraySize Number of values in the array, each process must use the same value.
+    * @param array Values of this process.
+    * @param operation MPI reduction operation.
+    * @return If true, the result was written successfully.*/
+   template<typename T> inline
+   bool Writer::writeWithDistributedReduction(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
+                                              const uint64_t& arraySize,T* array,MPI_Op operation) {
+      // The result is in a temporary buffer, batch mode would only queue a pointer to it:
+      if (batchMode == true) return false;
+
+      // First arraySize % N_processes processes receive one value more than the others:
+      const uint64_t sliceSize = arraySize / N_processes;
+      const uint64_t remainder = arraySize % N_processes;
+      if (sliceSize+1 > static_cast<uint64_t>(std::numeric_limits<int>::max())) return false;
+      std::vector<int> sliceSizes(N_processes);
+      for (int p=0; p<N_processes; ++p) sliceSizes[p] = sliceSize + (static_cast<uint64_t>(p) < remainder ? 1 : 0);
+
+      std::vector<T> slice(sliceSizes[myrank]+1);
+      if (MPI_Reduce_scatter(array,&(slice[0]),&(sliceSizes[0]),MPI_Type<T>(),operation,comm) != MPI_SUCCESS) return false;
+      return writeArray(arrayName,attribs,sliceSizes[myrank],1,&(slice[0]));
+   }
+
+   /** Reduce an array over all processes to master process and write the result. 
+    * The result is stored as a single element whose vector size is arraySize. 
+    * This function must be called by all processes, outside batch mode.
+    * @param arrayName Name of the XML tag for this array.
+    * @param attribs Attributes for the XML tag.
+    * @param arraySize Number of values in the array, each process must use the same value.
+    * @param array Values of this process.
+    * @param operation MPI reduction operation.
+    * @return If true, the result was written successfully.*/
    template<typename T> inline
    bool Writer::writeWithReduction(const std::string& arrayName,const std::map<std::string,std::string>& attribs,
                                    const uint64_t& arraySize,T* array,MPI_Op operation) {
+      // The result is in a temporary buffer, batch mode would only queue a pointer to it:
+      if (batchMode == true) return false;
+
       // Master process allocates a receive buffer for reduction:
       T* recvBuffer = NULL;
       if (myrank == masterRank) recvBuffer = new T[arraySize];
@@ -208,14 +485,15 @@ namespace vlsv {
 
       // Write result to file. Only master process has a non-zero array length, 
       // all other processes write a zero-length array:
+      bool success;
       if (myrank == masterRank) {
-         writeArray(arrayName,attribs,1,arraySize,recvBuffer);
+         success = writeArray(arrayName,attribs,1,arraySize,recvBuffer);
       } else {
-         writeArray(arrayName,attribs,0,0,recvBuffer);
+         success = writeArray(arrayName,attribs,0,0,recvBuffer);
       }
    
       delete [] recvBuffer; recvBuffer = NULL;
-      return true;
+      return success;
    }
 
 } // namespace vlsv
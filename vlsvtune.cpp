@@ -0,0 +1,83 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include "vlsv_hints.h"
+
+using namespace std;
+
+/** Find the best MPI-IO hints for the current job geometry and store them in a
+ * hint cache, see vlsv_hints.h. The benchmark writes a test file containing
+ * the given number of equally sized arrays. Programs that write VLSV files apply
+ * the cached hints if they call Writer::setHintCache. Exit value is zero if the
+ * hints were stored successfully.*/
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank,N_processes;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   MPI_Comm_size(MPI_COMM_WORLD,&N_processes);
+   const int masterRank = 0;
+
+   if (argn < 3) {
+      if (myRank == masterRank) {
+         cout << endl;
+         cout << "USAGE: mpirun -np <processes> ./vlsvtune <hint cache> <test file> [bytes per process] [arrays]" << endl;
+         cout << "Hints giving the fastest write of the test file are stored in the hint cache." << endl;
+         cout << "Each process writes 64 MiB of data in 16 arrays by default." << endl;
+         cout << endl;
+      }
+      MPI_Finalize();
+      return 1;
+   }
+
+   const string cacheFile = args[1];
+   const string testFile = args[2];
+   uint64_t bytesPerProcess = 64*1024*1024;
+   uint64_t N_arrays = 16;
+   if (argn > 3) bytesPerProcess = atol(args[3]);
+   if (argn > 4) N_arrays = atol(args[4]);
+   if (N_arrays == 0) N_arrays = 1;
+   vector<uint64_t> arrayBytes(N_arrays,bytesPerProcess*N_processes/N_arrays);
+
+   MPI_Info best;
+   double bestTime;
+   bool success = vlsv::tuneHints(testFile,MPI_COMM_WORLD,arrayBytes,best,bestTime);
+   if (success == true) {
+      if (vlsv::saveTunedHints(cacheFile,MPI_COMM_WORLD,best) == false) success = false;
+      MPI_Info_free(&best);
+   }
+
+   const string geometry = vlsv::getJobGeometry(MPI_COMM_WORLD);
+   if (myRank == masterRank) {
+      if (success == true) {
+         cout << "Hints for job geometry " << geometry << " stored in " << cacheFile << ", ";
+         cout << bytesPerProcess*N_processes/bestTime/1024/1024 << " MiB/s" << endl;
+      } else {
+         cerr << "Failed to tune hints for job geometry " << geometry << endl;
+      }
+   }
+
+   MPI_Finalize();
+   if (success == false) return 1;
+   return 0;
+}
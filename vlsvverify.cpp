@@ -0,0 +1,74 @@
+/** This file is part of VLSV file format.
+ *
+ *  Copyright 2011-2013 Finnish Meteorological Institute
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include "vlsv_reader_parallel.h"
+
+using namespace std;
+
+/** Verify the checksums of all arrays in the given VLSV files. Each file is
+ * read in parallel by all processes. Arrays written without checksums are skipped.
+ * Exit value is zero if all checksums were correct.*/
+int main(int argn,char* args[]) {
+   MPI_Init(&argn,&args);
+   int myRank;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   const int masterRank = 0;
+
+   if (argn < 2) {
+      if (myRank == masterRank) {
+         cout << endl;
+         cout << "USAGE: mpirun -np <processes> ./vlsvverify <input file(s)>" << endl;
+         cout << "Checksums of all arrays in each input file are verified." << endl;
+         cout << endl;
+      }
+      MPI_Finalize();
+      return 1;
+   }
+
+   bool success = true;
+   for (int i=1; i<argn; ++i) {
+      const string fileName = args[i];
+      vlsv::ParallelReader vlsvReader;
+      if (vlsvReader.open(fileName,MPI_COMM_WORLD,masterRank) == false) {
+         if (myRank == masterRank) cerr << fileName << ": failed to open file" << endl;
+         success = false;
+         continue;
+      }
+
+      uint64_t arraysVerified;
+      vector<string> failedArrays;
+      if (vlsvReader.verifyArrays(arraysVerified,failedArrays) == false) success = false;
+      vlsvReader.close();
+
+      if (myRank != masterRank) continue;
+      cout << fileName << ": " << arraysVerified << " arrays verified, " << failedArrays.size() << " failed" << endl;
+      for (size_t a=0; a<failedArrays.size(); ++a) {
+         cout << "\tchecksum mismatch in " << failedArrays[a] << endl;
+      }
+   }
+
+   MPI_Finalize();
+   if (success == false) return 1;
+   return 0;
+}